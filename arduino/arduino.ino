@@ -16,7 +16,7 @@
 
 Ticker ticker;
 fauxmoESP Alexa;
-AsyncWebServer httpServer(80);
+AsyncAdmissionServer httpServer(80);
 AsyncWebSocket webSocket("/ws");
 AsyncWiFiManager wifiManager;
 SprinklerHttp httpSprinkler;
@@ -46,7 +46,12 @@ void loop()
 {
   ArduinoOTA.handle();
   Alexa.handle();
-  Alarm.delay(0);
+  Schedule.handle();
+  Sprinkler.handle();
+  Button.handle();
+  Device.handle();
+  httpSprinkler.handle();
+  wssSprinkler.handle();
 }
 
 void setupDevice()
@@ -60,12 +65,12 @@ void setupWifi()
   WiFi.hostname(Device.hostname().c_str());
 
   wifiManager.onHandleRootRequest([](AsyncWebServerRequest *request)->AsyncWebServerResponse*{
-    return request->beginResponse_P(200, "text/html", SKETCH_SETUP_HTML_GZ, sizeof(SKETCH_SETUP_HTML_GZ));
+    return AsyncAssetHandler::beginResponse(request, "/setup.html");
   });
   wifiManager.onHandlePostRequest([](AsyncWebServerRequest *request)->AsyncWebServerResponse*{    
     Device.dispname(Url::decode(request->arg("name").c_str()).c_str());
     Device.hostname(Url::decode(request->arg("host").c_str()).c_str());
-    return request->beginResponse_P(200, "text/html", SKETCH_STATUS_HTML_GZ, sizeof(SKETCH_STATUS_HTML_GZ));
+    return AsyncAssetHandler::beginResponse(request, "/status.html");
   });
   wifiManager.onHandleInfoRequest([](AsyncWebServerRequest *request)->AsyncWebServerResponse*{
     return request->beginResponse(200, "application/json", "{ \"name\": \"" + Device.dispname() + "\", \"host\": \"" + Device.hostname() + "\" }");
@@ -75,6 +80,7 @@ void setupWifi()
   {
   case WM_FIRST_TIME_CONNECTED:
       Device.save();
+      Device.flush();
       ESP.reset();
       break;
   case WM_CONNECT_FAILED:
@@ -90,6 +96,7 @@ void setupOTA()
   // An important note: make sure that your project setting of Flash size is at least double of size of the compiled program. Otherwise OTA fails on out-of-memory.
   ArduinoOTA.onStart([]() {
     Serial.println("[MAIN] OTA: Start");
+    Device.flush();
   });
   ArduinoOTA.onEnd([]() {
     Serial.println("\n[MAIN] OTA: End");
@@ -149,7 +156,7 @@ void setupHttp()
 {
   // Setup Web UI
   Serial.println("[MAIN] Setup http server.");
-  httpSprinkler.setup(httpServer);
+  httpSprinkler.setup(httpServer, wssSprinkler);
   wssSprinkler.setup(webSocket);
   httpServer.addHandler(&webSocket);
   httpServer.begin();
@@ -0,0 +1,68 @@
+#ifndef SPRINKLER_LIB_ASSETS_H
+#define SPRINKLER_LIB_ASSETS_H
+
+#include <Arduino.h>
+
+// An entry of the asset index generated by buildArchive. The index is sorted
+// by path, all strings and the index itself live in flash.
+struct AssetEntry
+{
+  PGM_P path;
+  PGM_P mime;
+  uint32_t offset;  // into SKETCH_ASSETS, word aligned
+  uint32_t length;
+  PGM_P etag;
+  PGM_P encoding;   // "" - identity
+};
+
+// A gzipped page split at a marker by buildInjectable. The head is a gzip
+// header and a deflate stream ending in a non-final block, the tail is a
+// deflate stream of its own. Sizes and CRCs are of the uncompressed parts.
+struct InjectedAsset
+{
+  const uint8_t *head;  // in flash, word aligned
+  uint32_t headLength;
+  uint32_t headSize;
+  uint32_t headCrc;
+  const uint8_t *tail;  // in flash, word aligned
+  uint32_t tailLength;
+  uint32_t tailSize;
+  uint32_t tailCrc;
+  uint32_t tailShift;   // x^(8 * tailSize) modulo the CRC polynomial
+  const char *hash;
+};
+
+#include "../html/assets.h"
+
+class Assets
+{
+public:
+  // binary search over the generated index, copies the entry into RAM
+  static bool find(const char *path, AssetEntry &entry)
+  {
+    size_t low = 0, high = SKETCH_ASSETS_COUNT;
+    while (low < high)
+    {
+      size_t middle = (low + high) / 2;
+      int result = strcmp_P(path, (PGM_P)pgm_read_ptr(&SKETCH_ASSETS_INDEX[middle].path));
+      if (result == 0)
+      {
+        memcpy_P(&entry, &SKETCH_ASSETS_INDEX[middle], sizeof(entry));
+        return true;
+      }
+
+      if (result < 0)
+        high = middle;
+      else
+        low = middle + 1;
+    }
+    return false;
+  }
+
+  static const uint8_t *data(const AssetEntry &entry)
+  {
+    return SKETCH_ASSETS + entry.offset;
+  }
+};
+
+#endif
@@ -0,0 +1,209 @@
+#ifndef AsyncAdmissionServer_H
+#define AsyncAdmissionServer_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+#ifndef ADMISSION_MAX_REQUESTS
+#define ADMISSION_MAX_REQUESTS 8    // requests in flight at once, idle keep-alive and held ones do not count
+#endif
+#ifndef ADMISSION_MAX_HELD
+#define ADMISSION_MAX_HELD 4        // requests held open at once, the snapshot long-polls
+#endif
+#ifndef ADMISSION_MIN_HEAP
+#define ADMISSION_MIN_HEAP 8192     // bytes, below it new connections are shed
+#endif
+#ifndef ADMISSION_RATE
+#define ADMISSION_RATE 5            // requests per second per client address
+#endif
+#ifndef ADMISSION_BURST
+#define ADMISSION_BURST 10          // requests a client may send at once
+#endif
+#define ADMISSION_CLIENTS 8         // client addresses tracked by the rate limiter
+
+struct AdmissionStats
+{
+  uint32_t accepted;
+  uint32_t rejected;  // over the concurrency or the rate limit
+  uint32_t shed;      // heap too low
+  uint8_t active;     // requests in flight
+  uint8_t held;       // requests held open by hold()
+};
+
+// AsyncWebServer admitting connections before any request state is allocated.
+// Each AsyncWebServerRequest allocates header and param lists and Strings, so
+// an overloaded server answers from a static response instead: 503 when the
+// heap is low or too many requests are in flight, 429 when a client address
+// sends faster than its token bucket allows.
+//
+// A request counts as in flight from its first byte, a kept alive connection
+// waiting for the next request costs nothing. Requests held open until an
+// event answers them are budgeted apart, see hold().
+class AsyncAdmissionServer : public AsyncWebServer
+{
+private:
+  struct Bucket
+  {
+    uint32_t address;
+    uint32_t tokens;  // thousandths of a request
+    unsigned long time;
+  };
+
+  AdmissionStats stats;
+  Bucket buckets[ADMISSION_CLIENTS];
+  AsyncWebServerRequest *held[ADMISSION_MAX_HELD];
+
+  // the token bucket of address, the least recently used one is recycled
+  Bucket &bucket(uint32_t address, unsigned long time)
+  {
+    Bucket *oldest = &buckets[0];
+    for (Bucket &bucket : buckets)
+    {
+      if (bucket.address == address)
+        return bucket;
+      if ((long)(bucket.time - oldest->time) < 0)
+        oldest = &bucket;
+    }
+
+    *oldest = {address, ADMISSION_BURST * 1000UL, time};
+    return *oldest;
+  }
+
+  bool allow(uint32_t address)
+  {
+    unsigned long time = millis();
+    Bucket &client = bucket(address, time);
+
+    uint32_t tokens = client.tokens + (time - client.time) * ADMISSION_RATE;
+    client.tokens = tokens < ADMISSION_BURST * 1000UL ? tokens : ADMISSION_BURST * 1000UL;
+    client.time = time;
+
+    if (client.tokens < 1000)
+      return false;
+
+    client.tokens -= 1000;
+    return true;
+  }
+
+  // answers the request with a static response once it arrives and closes,
+  // every callback is replaced, a kept alive client may still point at the
+  // request it served last
+  static void refuse(AsyncClient *client, const char *response)
+  {
+    client->setRxTimeout(3);
+    client->onError(nullptr, nullptr);
+    client->onAck(nullptr, nullptr);
+    client->onPoll(nullptr, nullptr);
+    client->onData([](void *response, AsyncClient *client, void *data, size_t len) {
+      (void)data;
+      (void)len;
+      client->onData(nullptr, nullptr);
+      client->write((const char *)response, strlen((const char *)response), 0);
+      client->close();
+    }, (void *)response);
+    client->onTimeout([](void *arg, AsyncClient *client, uint32_t time) {
+      (void)arg;
+      (void)time;
+      client->close(true);
+    }, nullptr);
+    client->onDisconnect([](void *arg, AsyncClient *client) {
+      (void)arg;
+      delete client;
+    }, nullptr);
+  }
+
+public:
+  AsyncAdmissionServer(uint16_t port) : AsyncWebServer(port), stats(), buckets(), held()
+  {
+  }
+
+  // moves an in flight request to the held budget until it is deleted,
+  // false when ADMISSION_MAX_HELD are held already. A held request receives
+  // nothing more, so the receive timeout of the connection is lifted.
+  bool hold(AsyncWebServerRequest *request)
+  {
+    for (AsyncWebServerRequest *&slot : held)
+    {
+      if (!slot)
+      {
+        request->client()->setRxTimeout(0);
+        slot = request;
+        stats.held++;
+        if (stats.active)
+          stats.active--;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  const AdmissionStats &getStats() const
+  {
+    return stats;
+  }
+
+  virtual AsyncWebServerRequest *_handleClient(AsyncClient *client) override
+  {
+    // kept in RAM, lwIP must not read them from flash
+    static const char unavailable[] =
+        "HTTP/1.1 503 Service Unavailable\r\n"
+        "Retry-After: 2\r\n"
+        "Content-Length: 0\r\n"
+        "Connection: close\r\n\r\n";
+    static const char tooMany[] =
+        "HTTP/1.1 429 Too Many Requests\r\n"
+        "Retry-After: 1\r\n"
+        "Content-Length: 0\r\n"
+        "Connection: close\r\n\r\n";
+
+    if (ESP.getFreeHeap() < ADMISSION_MIN_HEAP)
+    {
+      stats.shed++;
+      refuse(client, unavailable);
+      return nullptr;
+    }
+
+    if (stats.active >= ADMISSION_MAX_REQUESTS)
+    {
+      stats.rejected++;
+      refuse(client, unavailable);
+      return nullptr;
+    }
+
+    if (!allow(client->getRemoteAddress()))
+    {
+      stats.rejected++;
+      refuse(client, tooMany);
+      return nullptr;
+    }
+
+    AsyncWebServerRequest *request = AsyncWebServer::_handleClient(client);
+    if (request)
+      stats.accepted++;
+    return request;
+  }
+
+  virtual void _handleRequestStart(AsyncWebServerRequest *request) override
+  {
+    (void)request;
+    stats.active++;
+  }
+
+  virtual void _handleRequestEnd(AsyncWebServerRequest *request) override
+  {
+    for (AsyncWebServerRequest *&slot : held)
+    {
+      if (slot == request)
+      {
+        slot = nullptr;
+        stats.held--;
+        return;
+      }
+    }
+
+    if (stats.active)
+      stats.active--;
+  }
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef AsyncAssetHandler_H
+#define AsyncAssetHandler_H
+
+#include <Arduino.h>
+#include "Assets.h"
+#include "AsyncFlashResponse.h"
+
+// Catch-all handler serving every asset of the generated archive, adding an
+// asset to the html folder needs no C++ changes.
+class AsyncAssetHandler : public AsyncWebHandler
+{
+public:
+  static AsyncWebServerResponse *beginResponse(AsyncWebServerRequest *request, const AssetEntry &entry)
+  {
+    AsyncWebServerResponse *response = new AsyncFlashResponse(200, FPSTR(entry.mime), Assets::data(entry), entry.length);
+    if (pgm_read_byte(entry.encoding))
+    {
+      response->addHeader("Content-Encoding", FPSTR(entry.encoding));
+    }
+    return response;
+  }
+
+  // the response of the asset at path, 404 if the archive does not have it
+  static AsyncWebServerResponse *beginResponse(AsyncWebServerRequest *request, const char *path)
+  {
+    AssetEntry entry;
+    if (!Assets::find(path, entry))
+      return request->beginResponse(404);
+
+    return beginResponse(request, entry);
+  }
+
+protected:
+  virtual bool canHandle(AsyncWebServerRequest *request) override final
+  {
+    if (request->method() != HTTP_GET)
+      return false;
+
+    AssetEntry entry;
+    if (!Assets::find(request->url().c_str(), entry))
+      return false;
+
+    request->addInterestingHeader("If-None-Match");
+    return true;
+  }
+
+  virtual void handleRequest(AsyncWebServerRequest *request) override final
+  {
+    AssetEntry entry;
+    if (!Assets::find(request->url().c_str(), entry))
+      return request->send(404);
+
+    String etag = FPSTR(entry.etag);
+
+    // the url of a versioned asset changes with its content, let it be cached for good
+    const char *cacheControl = request->hasArg("v") ? "public, max-age=31536000, immutable" : "no-cache";
+
+    AsyncWebServerResponse *response;
+    if (request->header("If-None-Match").equals(etag))
+    {
+      response = request->beginResponse(304);
+    }
+    else
+    {
+      response = beginResponse(request, entry);
+    }
+
+    // strong validator generated from the content at build time, see buildArchive
+    response->addHeader("ETag", etag);
+    response->addHeader("Cache-Control", cacheControl);
+    request->send(response);
+  }
+
+  virtual bool isRequestHandlerTrivial() override final
+  {
+    return false;
+  }
+};
+
+#endif
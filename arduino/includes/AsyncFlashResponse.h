@@ -0,0 +1,168 @@
+#ifndef AsyncFlashResponse_H
+#define AsyncFlashResponse_H
+
+#include <Arduino.h>
+
+#define FLASH_RESPONSE_CHUNK 512    // bytes copied out of flash at a time
+#define FLASH_RESPONSE_SEGMENTS 5
+
+struct FlashResponseSegment
+{
+  const uint8_t *data;
+  size_t length;
+  bool progmem;
+};
+
+// Response for PROGMEM content. AsyncProgmemResponse mallocs a buffer as large
+// as the TCP window on every ack. This one fills the whole window through a
+// small static, word aligned bounce buffer and lets lwIP copy each chunk into
+// its own pbufs, so no heap is used per chunk.
+//
+// It is not zero-copy. Every byte is still copied out of flash into the
+// bounce buffer and from there into a pbuf, as it was through the malloced
+// buffer. The content cannot be handed to tcp_write by reference: lwIP reads
+// payloads with byte and half-word loads (checksums, the WiFi glue), flash
+// only allows aligned 32-bit reads.
+//
+// The body may be made of a few segments, in flash or in RAM, sent in order.
+class AsyncFlashResponse : public AsyncWebServerResponse
+{
+private:
+  String _head;
+  size_t _headSent;
+  FlashResponseSegment _segments[FLASH_RESPONSE_SEGMENTS];
+  uint8_t _segmentCount;
+  uint8_t _segment;       // the segment being sent
+  size_t _segmentSent;
+
+  static uint8_t *buffer()
+  {
+    // responses run in the TCP callbacks one at a time, they share the buffer
+    static uint32_t chunk[FLASH_RESPONSE_CHUNK / 4];
+    return (uint8_t *)chunk;
+  }
+
+  size_t add(AsyncClient *client, const uint8_t *data, size_t size, bool more)
+  {
+    return client->add((const char *)data, size, ASYNC_WRITE_FLAG_COPY | (more ? ASYNC_WRITE_FLAG_MORE : 0));
+  }
+
+public:
+  AsyncFlashResponse(int code, const String &contentType)
+      : _headSent(0), _segmentCount(0), _segment(0), _segmentSent(0)
+  {
+    _code = code;
+    _contentType = contentType;
+    _contentLength = 0;
+  }
+
+  AsyncFlashResponse(int code, const String &contentType, const uint8_t *content, size_t len)
+      : AsyncFlashResponse(code, contentType)
+  {
+    append(content, len);
+  }
+
+  // appends a segment to the body, the data must outlive the response
+  bool append(const uint8_t *data, size_t length, bool progmem = true)
+  {
+    if (_segmentCount >= FLASH_RESPONSE_SEGMENTS)
+      return false;
+
+    _segments[_segmentCount++] = {data, length, progmem};
+    _contentLength += length;
+    return true;
+  }
+
+  bool _sourceValid() const override
+  {
+    return true;
+  }
+
+  void _respond(AsyncWebServerRequest *request) override
+  {
+    _head = _assembleHead(request->version());
+    _headLength = _head.length();
+    _state = RESPONSE_HEADERS;
+    _ack(request, 0, 0);
+  }
+
+  size_t _ack(AsyncWebServerRequest *request, size_t len, uint32_t time) override
+  {
+    (void)time;
+    _ackedLength += len;
+
+    AsyncClient *client = request->client();
+    size_t written = 0;
+
+    if (_state == RESPONSE_HEADERS)
+    {
+      size_t size = add(client, (const uint8_t *)_head.c_str() + _headSent, _headLength - _headSent, _contentLength > 0);
+      _headSent += size;
+      written += size;
+
+      if (_headSent == _headLength)
+      {
+        _head = String();
+        _state = _contentLength ? RESPONSE_CONTENT : RESPONSE_WAIT_ACK;
+      }
+    }
+
+    // fill the send window, chunk by chunk, in word aligned reads
+    while (_state == RESPONSE_CONTENT)
+    {
+      const FlashResponseSegment &segment = _segments[_segment];
+      const uint8_t *data = segment.data + _segmentSent;
+      size_t size = segment.length - _segmentSent;
+      size_t space = client->space();
+      if (size > space)
+        size = space;
+      if (segment.progmem && size > FLASH_RESPONSE_CHUNK)
+        size = FLASH_RESPONSE_CHUNK;
+      if (!size && segment.length)
+        break;
+
+      if (segment.progmem && size)
+      {
+        memcpy_P(buffer(), data, size);
+        data = buffer();
+      }
+
+      if (size)
+      {
+        size = add(client, data, size, _sentLength + size < _contentLength);
+        if (!size)
+          break;
+      }
+
+      _segmentSent += size;
+      _sentLength += size;
+      written += size;
+
+      if (_segmentSent == segment.length)
+      {
+        _segment++;
+        _segmentSent = 0;
+      }
+
+      if (_sentLength == _contentLength)
+      {
+        _state = RESPONSE_WAIT_ACK;
+      }
+    }
+
+    if (written)
+    {
+      client->send();
+      _writtenLength += written;
+      return written;
+    }
+
+    if (_state == RESPONSE_WAIT_ACK && _ackedLength >= _writtenLength)
+    {
+      _state = RESPONSE_END;
+    }
+    return 0;
+  }
+};
+
+#endif
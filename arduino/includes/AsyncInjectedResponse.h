@@ -0,0 +1,100 @@
+#ifndef AsyncInjectedResponse_H
+#define AsyncInjectedResponse_H
+
+#include <Arduino.h>
+#include "Assets.h"
+#include "AsyncFlashResponse.h"
+#include "PrintBuffer.h"
+
+// A precompressed page with content printed into it at serve time. The
+// content goes in as a stored (uncompressed) deflate block between the head
+// and the tail, so the static parts are never compressed on the device and
+// the result is still a single gzip member every browser accepts. The gzip
+// trailer is combined from the build-time CRCs and the CRC of the content.
+template <size_t N>
+class AsyncInjectedResponse : public AsyncFlashResponse
+{
+private:
+  const InjectedAsset &_asset;
+  PrintBuffer<N> _content;
+  uint8_t _stored[5];   // BFINAL 0, BTYPE 00, LEN, NLEN
+  uint8_t _trailer[8];  // CRC32, ISIZE
+
+  static uint32_t crc32(uint32_t crc, const uint8_t *data, size_t size)
+  {
+    crc = ~crc;
+    while (size--)
+    {
+      crc ^= *data++;
+      for (uint8_t i = 0; i < 8; i++)
+      {
+        crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+      }
+    }
+    return ~crc;
+  }
+
+  // a * b modulo the CRC polynomial, bit 31 is x^0
+  static uint32_t multmodp(uint32_t a, uint32_t b)
+  {
+    uint32_t m = 1UL << 31, p = 0;
+    for (;;)
+    {
+      if (a & m)
+      {
+        p ^= b;
+        if ((a & (m - 1)) == 0)
+          break;
+      }
+      m >>= 1;
+      b = b & 1 ? (b >> 1) ^ 0xEDB88320 : b >> 1;
+    }
+    return p;
+  }
+
+  static void put32(uint8_t *out, uint32_t value)
+  {
+    for (uint8_t i = 0; i < 4; i++)
+    {
+      out[i] = value >> (8 * i);
+    }
+  }
+
+public:
+  AsyncInjectedResponse(const String &contentType, const InjectedAsset &asset)
+      : AsyncFlashResponse(200, contentType), _asset(asset)
+  {
+    addHeader("Content-Encoding", "gzip");
+  }
+
+  // print the content here before the response is sent
+  Print &content()
+  {
+    return _content;
+  }
+
+  void _respond(AsyncWebServerRequest *request) override
+  {
+    uint16_t length = _content.length();
+    uint16_t nlength = ~length;
+    _stored[0] = 0;
+    _stored[1] = length;
+    _stored[2] = length >> 8;
+    _stored[3] = nlength;
+    _stored[4] = nlength >> 8;
+
+    uint32_t crc = crc32(_asset.headCrc, (const uint8_t *)_content.c_str(), length);
+    put32(_trailer, multmodp(_asset.tailShift, crc) ^ _asset.tailCrc);
+    put32(_trailer + 4, _asset.headSize + length + _asset.tailSize);
+
+    append(_asset.head, _asset.headLength);
+    append(_stored, sizeof(_stored), false);
+    append((const uint8_t *)_content.c_str(), length, false);
+    append(_asset.tail, _asset.tailLength);
+    append(_trailer, sizeof(_trailer), false);
+
+    AsyncFlashResponse::_respond(request);
+  }
+};
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef AsyncRouteHandler_H
+#define AsyncRouteHandler_H
+
+#include <Arduino.h>
+
+// One handler for a whole table of routes. The table is sorted by path, so a
+// request is matched with a binary search instead of a String compare per
+// registered handler. A path ending with '/' takes the last path segment as
+// a parameter, e.g. "/api/schedule/" matches "/api/schedule/mon" and passes
+// "mon" (pointing into the request url, nothing is copied).
+template <typename T>
+class AsyncRouteHandler : public AsyncWebHandler
+{
+public:
+  typedef void (T::*Action)(AsyncWebServerRequest *request);
+  typedef void (T::*ParamAction)(AsyncWebServerRequest *request, const char *param);
+
+  struct Route
+  {
+    WebRequestMethodComposite method;
+    const char *path;
+    Action action;
+    ParamAction paramAction;
+  };
+
+  template <size_t N>
+  AsyncRouteHandler(T *target, const Route (&routes)[N])
+      : _target(target), _routes(routes), _count(N)
+  {
+    for (size_t i = 1; i < _count; i++)
+    {
+      if (strcmp(_routes[i - 1].path, _routes[i].path) > 0)
+      {
+        Serial.printf("[HTTP] route %s is out of order\n", _routes[i].path);
+      }
+    }
+  }
+
+protected:
+  virtual bool canHandle(AsyncWebServerRequest *request) override final
+  {
+    const char *param;
+    if (!find(request, param))
+      return false;
+
+    // conditional GETs are the only headers the routes look at, the name is
+    // longer than String's small buffer and built once
+    static const String ifNoneMatch = F("If-None-Match");
+    request->addInterestingHeader(ifNoneMatch);
+    return true;
+  }
+
+  virtual void handleRequest(AsyncWebServerRequest *request) override final
+  {
+    const char *param;
+    const Route *route = find(request, param);
+    if (!route)
+      return request->send(404);
+
+    if (route->paramAction)
+    {
+      (_target->*route->paramAction)(request, param);
+    }
+    else
+    {
+      (_target->*route->action)(request);
+    }
+  }
+
+  virtual bool isRequestHandlerTrivial() override final
+  {
+    return false;
+  }
+
+private:
+  T *_target;
+  const Route *_routes;
+  size_t _count;
+
+  // compares a route path with the first length chars of url
+  static int compare(const char *path, const char *url, size_t length)
+  {
+    int result = strncmp(path, url, length);
+    if (result)
+      return result;
+    return path[length] ? 1 : 0;
+  }
+
+  const Route *find(const char *url, size_t length, WebRequestMethodComposite method)
+  {
+    size_t low = 0, high = _count;
+    while (low < high)
+    {
+      size_t middle = (low + high) / 2;
+      if (compare(_routes[middle].path, url, length) < 0)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+
+    // the same path may be listed once per method
+    for (; low < _count && compare(_routes[low].path, url, length) == 0; low++)
+    {
+      if (_routes[low].method & method)
+        return &_routes[low];
+    }
+    return nullptr;
+  }
+
+  const Route *find(AsyncWebServerRequest *request, const char *&param)
+  {
+    const char *url = request->url().c_str();
+    size_t length = strlen(url);
+
+    param = nullptr;
+    const Route *route = find(url, length, request->method());
+    if (route && !route->paramAction)
+      return route;
+
+    const char *slash = strrchr(url, '/');
+    if (!slash)
+      return nullptr;
+
+    route = find(url, slash - url + 1, request->method());
+    if (!route || !route->paramAction)
+      return nullptr;
+
+    param = slash + 1;
+    return route;
+  }
+};
+
+#endif
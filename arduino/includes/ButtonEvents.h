@@ -0,0 +1,156 @@
+#ifndef SPRINKLER_LIB_BUTTONEVENTS_H
+#define SPRINKLER_LIB_BUTTONEVENTS_H
+
+#include <Arduino.h>
+#include <StaticDelegate.h>
+
+#define BUTTON_QUEUE_SIZE 16        // edges, power of two
+#define BUTTON_DEBOUNCE_MS 30       // a level must be stable that long to count
+#define BUTTON_LONG_PRESS_MS 1000   // held at least that long - long press
+#define BUTTON_DOUBLE_PRESS_MS 400  // second click within that window - double press
+
+// Push button handled outside of interrupt context. The ISR only records a
+// timestamped edge into a single-producer ring, loop() drains it through a
+// debouncer and turns the clicks into short, long and double presses.
+class ButtonEvents
+{
+private:
+  volatile uint32_t edgeTime[BUTTON_QUEUE_SIZE];
+  volatile uint8_t edgeLevel[BUTTON_QUEUE_SIZE];
+  volatile uint8_t head;  // written by the ISR only
+  volatile uint8_t tail;  // written by handle() only
+  volatile bool overflow;
+
+  uint8_t pin;
+  uint8_t activeLevel;
+
+  uint8_t rawLevel;  // last level seen, may still bounce
+  uint32_t rawTime;
+  bool pressed;      // debounced state
+  bool longPressed;
+  uint8_t clicks;
+  uint32_t pressTime;
+  uint32_t releaseTime;
+
+  StaticDelegate onShortPressEvent;
+  StaticDelegate onLongPressEvent;
+  StaticDelegate onDoublePressEvent;
+
+  static void ICACHE_RAM_ATTR interruptHandler(void *arg)
+  {
+    ButtonEvents *button = static_cast<ButtonEvents *>(arg);
+
+    uint8_t next = (button->head + 1) & (BUTTON_QUEUE_SIZE - 1);
+    if (next == button->tail)
+    {
+      button->overflow = true;
+      return;
+    }
+
+    button->edgeTime[button->head] = millis();
+    button->edgeLevel[button->head] = digitalRead(button->pin);
+    button->head = next;
+  }
+
+  void settle(uint32_t time)
+  {
+    bool level = rawLevel == activeLevel;
+    if (level == pressed || time - rawTime < BUTTON_DEBOUNCE_MS)
+      return;
+
+    pressed = level;
+    if (pressed)
+    {
+      pressTime = rawTime;
+      longPressed = false;
+    }
+    else if (!longPressed)
+    {
+      releaseTime = rawTime;
+      if (++clicks == 2)
+      {
+        clicks = 0;
+        onDoublePressEvent();
+      }
+    }
+  }
+
+public:
+  ButtonEvents() : head(0), tail(0), overflow(false), pin(0), activeLevel(LOW), rawLevel(HIGH), rawTime(0),
+                   pressed(false), longPressed(false), clicks(0), pressTime(0), releaseTime(0)
+  {
+  }
+
+  void setup(uint8_t buttonPin, uint8_t active = LOW)
+  {
+    pin = buttonPin;
+    activeLevel = active;
+    rawLevel = digitalRead(pin);
+    rawTime = millis();
+    pressed = rawLevel == activeLevel;
+
+    attachInterruptArg(digitalPinToInterrupt(pin), interruptHandler, this, CHANGE);
+  }
+
+  void onShortPress(StaticDelegate event)
+  {
+    onShortPressEvent = event;
+  }
+
+  void onLongPress(StaticDelegate event)
+  {
+    onLongPressEvent = event;
+  }
+
+  void onDoublePress(StaticDelegate event)
+  {
+    onDoublePressEvent = event;
+  }
+
+  // call it from loop()
+  void handle()
+  {
+    while (tail != head)
+    {
+      uint32_t time = edgeTime[tail];
+      uint8_t level = edgeLevel[tail];
+      tail = (tail + 1) & (BUTTON_QUEUE_SIZE - 1);
+
+      // the previous level counts only if it outlived the debounce period
+      settle(time);
+      rawLevel = level;
+      rawTime = time;
+    }
+
+    if (overflow)
+    {
+      // the queued edges no longer add up to the pin level, start over from
+      // the pin and drop the gesture in progress
+      overflow = false;
+      tail = head;
+      rawLevel = digitalRead(pin);
+      rawTime = millis();
+      clicks = 0;
+      Serial.println("[BUTTON] edges dropped");
+    }
+
+    uint32_t time = millis();
+    settle(time);
+
+    if (pressed && !longPressed && time - pressTime >= BUTTON_LONG_PRESS_MS)
+    {
+      longPressed = true;
+      clicks = 0;
+      onLongPressEvent();
+    }
+    else if (!pressed && clicks == 1 && time - releaseTime >= BUTTON_DOUBLE_PRESS_MS)
+    {
+      clicks = 0;
+      onShortPressEvent();
+    }
+  }
+};
+
+extern ButtonEvents Button = ButtonEvents();
+
+#endif
@@ -0,0 +1,299 @@
+#ifndef SPRINKLER_LIB_CONFIGJOURNAL_H
+#define SPRINKLER_LIB_CONFIGJOURNAL_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+#define JOURNAL_SECTOR_SIZE 4096
+#define JOURNAL_MAGIC 0x4C4A5053  // "SPJL"
+#define JOURNAL_MAX_KEYS 64
+#define JOURNAL_MAX_RECORD 64     // bytes of data in one record
+#define JOURNAL_EMPTY_KEY 0xFF    // erased flash
+
+struct JournalSector
+{
+  uint32_t magic;
+  uint32_t sequence;  // the valid sector with the highest sequence is active
+};
+
+struct JournalRecord
+{
+  uint8_t key;
+  uint8_t length;
+  uint16_t crc;  // over key, length and data
+};
+
+// a record as it is read and written, the header followed by its data
+// padded to whole words
+struct JournalEntry
+{
+  JournalRecord record;
+  uint32_t data[JOURNAL_MAX_RECORD / 4];
+};
+
+static_assert(offsetof(JournalEntry, data) == sizeof(JournalRecord), "journal data must follow the record header");
+
+// outcome of ConfigJournal::write()
+enum JournalResult
+{
+  journalUnchanged,  // the stored value is the same, nothing was written
+  journalWritten,
+  journalFailed      // the flash failed, the previous value stays current
+};
+
+// Log-structured key/value store spread over a few flash sectors. A write
+// appends a small CRC protected record, and only if the value differs from
+// the stored one. When the active sector fills up, the latest record of every
+// key is copied into the next sector, so erases rotate over all sectors.
+// The new sector header is written last, a power loss or a failed write
+// during compaction leaves the previous sector active and readable.
+class ConfigJournal
+{
+private:
+  uint32_t first;    // first flash sector number
+  uint8_t sectors;
+  uint8_t active;
+  uint32_t sequence;
+  uint16_t offset;   // append position in the active sector
+  uint16_t latest[JOURNAL_MAX_KEYS];  // offset of the last record per key, 0 - none
+
+  static uint16_t align(uint16_t size)
+  {
+    return (size + 3) & ~3;
+  }
+
+  static uint16_t crc16(const uint8_t *data, size_t size, uint16_t crc = 0xFFFF)
+  {
+    while (size--)
+    {
+      crc ^= (uint16_t)(*data++) << 8;
+      for (uint8_t i = 0; i < 8; i++)
+      {
+        crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+      }
+    }
+    return crc;
+  }
+
+  static uint16_t checksum(const JournalRecord &record, const uint8_t *data)
+  {
+    return crc16(data, record.length, crc16(&record.key, 2));
+  }
+
+  uint32_t address(uint8_t sector, uint16_t position)
+  {
+    return (first + sector) * JOURNAL_SECTOR_SIZE + position;
+  }
+
+  // reads the record at position into entry, header first, then the data
+  bool readRecord(uint8_t sector, uint16_t position, JournalEntry &entry)
+  {
+    if (position + sizeof(JournalRecord) > JOURNAL_SECTOR_SIZE)
+      return false;
+
+    if (!ESP.flashRead(address(sector, position), (uint32_t *)&entry.record, sizeof(JournalRecord)))
+      return false;
+
+    const JournalRecord &record = entry.record;
+    if (record.key == JOURNAL_EMPTY_KEY || record.key >= JOURNAL_MAX_KEYS || record.length > JOURNAL_MAX_RECORD)
+      return false;
+
+    uint16_t size = align(record.length);
+    if (position + sizeof(JournalRecord) + size > JOURNAL_SECTOR_SIZE)
+      return false;
+
+    if (size && !ESP.flashRead(address(sector, position + sizeof(JournalRecord)), entry.data, size))
+      return false;
+
+    return record.crc == checksum(record, (const uint8_t *)entry.data);
+  }
+
+  void scan()
+  {
+    memset(latest, 0, sizeof(latest));
+
+    JournalEntry entry;
+    offset = sizeof(JournalSector);
+    while (readRecord(active, offset, entry))
+    {
+      latest[entry.record.key] = offset;
+      offset += sizeof(JournalRecord) + align(entry.record.length);
+    }
+
+    uint32_t tail = 0xFFFFFFFF;
+    if (offset + sizeof(tail) <= JOURNAL_SECTOR_SIZE)
+      ESP.flashRead(address(active, offset), &tail, sizeof(tail));
+
+    if (tail != 0xFFFFFFFF)
+    {
+      // a torn write, the rest of the sector is not erased, append elsewhere
+      Serial.println("[JOURNAL] damaged record, compacting");
+      offset = JOURNAL_SECTOR_SIZE;
+    }
+  }
+
+  // writes the entry at position and notes it in index, the offset table
+  bool append(uint8_t sector, uint16_t &position, const JournalEntry &entry, uint16_t *index)
+  {
+    uint16_t size = sizeof(JournalRecord) + align(entry.record.length);
+    if (position + size > JOURNAL_SECTOR_SIZE)
+      return false;
+
+    if (!ESP.flashWrite(address(sector, position), (uint32_t *)&entry, size))
+      return false;
+
+    index[entry.record.key] = position;
+    position += size;
+    return true;
+  }
+
+  bool activate(uint8_t sector)
+  {
+    JournalSector header = {JOURNAL_MAGIC, sequence + 1};
+    if (!ESP.flashWrite(address(sector, 0), (uint32_t *)&header, sizeof(header)))
+      return false;
+
+    sequence = header.sequence;
+    active = sector;
+    return true;
+  }
+
+  bool compact()
+  {
+    uint8_t next = (active + 1) % sectors;
+    Serial.print("[JOURNAL] compacting into sector ");
+    Serial.println(first + next);
+
+    if (!ESP.flashEraseSector(first + next))
+      return false;
+
+    // the copies are indexed aside, latest keeps pointing into the active
+    // sector until the new one is complete and activated
+    uint16_t moved[JOURNAL_MAX_KEYS] = {};
+    JournalEntry entry;
+    uint16_t position = sizeof(JournalSector);
+    for (uint8_t key = 0; key < JOURNAL_MAX_KEYS; key++)
+    {
+      if (!latest[key])
+        continue;
+
+      if (!readRecord(active, latest[key], entry) || !append(next, position, entry, moved))
+        return false;
+    }
+
+    if (!activate(next))
+      return false;
+
+    memcpy(latest, moved, sizeof(latest));
+    offset = position;
+    return true;
+  }
+
+public:
+  ConfigJournal() : first(0), sectors(0), active(0), sequence(0), offset(JOURNAL_SECTOR_SIZE), latest()
+  {
+  }
+
+  // mounts the journal on sectors [firstSector, firstSector + count)
+  bool begin(uint32_t firstSector, uint8_t count)
+  {
+    first = firstSector;
+    sectors = count;
+    sequence = 0;
+    if (!sectors)
+      return false;
+
+    bool found = false;
+    for (uint8_t sector = 0; sector < sectors; sector++)
+    {
+      JournalSector header;
+      if (ESP.flashRead(address(sector, 0), (uint32_t *)&header, sizeof(header)) && header.magic == JOURNAL_MAGIC)
+      {
+        if (!found || (int32_t)(header.sequence - sequence) > 0)
+        {
+          found = true;
+          active = sector;
+          sequence = header.sequence;
+        }
+      }
+    }
+
+    if (!found)
+      return clear();
+
+    scan();
+    return true;
+  }
+
+  bool empty()
+  {
+    for (uint8_t key = 0; key < JOURNAL_MAX_KEYS; key++)
+    {
+      if (latest[key])
+        return false;
+    }
+    return true;
+  }
+
+  // reads the latest value of key, fails if it is missing or has another size
+  bool read(uint8_t key, void *data, uint8_t size)
+  {
+    if (key >= JOURNAL_MAX_KEYS || !latest[key])
+      return false;
+
+    JournalEntry entry;
+    if (!readRecord(active, latest[key], entry) || entry.record.length != size)
+      return false;
+
+    memcpy(data, entry.data, size);
+    return true;
+  }
+
+  // appends the value of key unless it is already stored
+  JournalResult write(uint8_t key, const void *data, uint8_t size)
+  {
+    if (!sectors || key >= JOURNAL_MAX_KEYS || size > JOURNAL_MAX_RECORD)
+      return journalFailed;
+
+    JournalEntry entry;
+    if (latest[key] && readRecord(active, latest[key], entry) &&
+        entry.record.length == size && memcmp(entry.data, data, size) == 0)
+    {
+      return journalUnchanged;
+    }
+
+    entry.record.key = key;
+    entry.record.length = size;
+    memset(entry.data, 0xFF, align(size));
+    memcpy(entry.data, data, size);
+    entry.record.crc = checksum(entry.record, (const uint8_t *)entry.data);
+
+    if (offset + sizeof(JournalRecord) + align(size) > JOURNAL_SECTOR_SIZE && !compact())
+      return journalFailed;
+
+    if (!append(active, offset, entry, latest))
+    {
+      // the failed write may have programmed part of the record, the next
+      // one compacts instead of writing over it
+      offset = JOURNAL_SECTOR_SIZE;
+      return journalFailed;
+    }
+    return journalWritten;
+  }
+
+  // erases every sector and starts an empty journal
+  bool clear()
+  {
+    memset(latest, 0, sizeof(latest));
+    for (uint8_t sector = 0; sector < sectors; sector++)
+    {
+      if (!ESP.flashEraseSector(first + sector))
+        return false;
+    }
+
+    offset = sizeof(JournalSector);
+    return activate(0);
+  }
+};
+
+#endif
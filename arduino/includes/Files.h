@@ -1,13 +1,9 @@
 #ifndef SPRINKLER_FILES_H
 #define SPRINKLER_FILES_H
 
-#include "../html/index.html.gz.h"
-#include "../html/favicon.png.gz.h"
-#include "../html/apple-touch-icon.png.gz.h"
-#include "../html/manifest.json.gz.h"
-#include "../html/setup.html.gz.h"
-#include "../html/status.html.gz.h"
+#include "Assets.h"
 
 #include "../html/settings.json.h"
+#include "../html/index.html.inject.h"
 
 #endif
@@ -0,0 +1,36 @@
+#ifndef JsonString_H
+#define JsonString_H
+
+#include <Arduino.h>
+
+// prints value as a quoted JSON string, quotes, backslashes and control
+// characters escaped, for text that comes from the user
+inline size_t printJsonString(Print &out, const char *value)
+{
+  static const char hex[] = "0123456789abcdef";
+
+  size_t n = out.print('"');
+  for (const char *c = value; *c; c++)
+  {
+    uint8_t ch = *c;
+    if (ch == '"' || ch == '\\')
+    {
+      n += out.print('\\');
+      n += out.print((char)ch);
+    }
+    else if (ch < 0x20)
+    {
+      n += out.print("\\u00");
+      n += out.print(hex[ch >> 4]);
+      n += out.print(hex[ch & 0x0f]);
+    }
+    else
+    {
+      n += out.print((char)ch);
+    }
+  }
+  n += out.print('"');
+  return n;
+}
+
+#endif
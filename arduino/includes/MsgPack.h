@@ -0,0 +1,64 @@
+#ifndef MsgPack_H
+#define MsgPack_H
+
+#include <Arduino.h>
+
+// The few MessagePack types the state frames need, printed straight to a
+// Print like the JSON writers are, without building a document first. Maps
+// are keyed by small integer field ids instead of names.
+class MsgPack
+{
+private:
+  static size_t big(Print &out, uint8_t type, uint32_t value, uint8_t size)
+  {
+    uint8_t data[5] = {type};
+    for (uint8_t i = 0; i < size; i++)
+    {
+      data[size - i] = value >> (8 * i);
+    }
+    return out.write(data, size + 1);
+  }
+
+public:
+  // up to 15 entries
+  static size_t map(Print &out, uint8_t size)
+  {
+    return out.write(0x80 | (size & 0x0f));
+  }
+
+  static size_t key(Print &out, uint8_t id)
+  {
+    return out.write(id & 0x7f);
+  }
+
+  static size_t uint32(Print &out, uint32_t value)
+  {
+    if (value < 0x80)
+      return out.write((uint8_t)value);
+    if (value <= 0xff)
+      return big(out, 0xcc, value, 1);
+    if (value <= 0xffff)
+      return big(out, 0xcd, value, 2);
+    return big(out, 0xce, value, 4);
+  }
+
+  static size_t int32(Print &out, int32_t value)
+  {
+    if (value >= 0)
+      return uint32(out, value);
+    if (value >= -32)
+      return out.write((uint8_t)value);
+    if (value >= -128)
+      return big(out, 0xd0, value, 1);
+    if (value >= -32768)
+      return big(out, 0xd1, value, 2);
+    return big(out, 0xd2, value, 4);
+  }
+
+  static size_t boolean(Print &out, bool value)
+  {
+    return out.write(value ? 0xc3 : 0xc2);
+  }
+};
+
+#endif
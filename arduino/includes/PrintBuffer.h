@@ -0,0 +1,52 @@
+#ifndef SPRINKLER_LIB_PRINTBUFFER_H
+#define SPRINKLER_LIB_PRINTBUFFER_H
+
+#include <Arduino.h>
+
+// Print into a fixed, stack or statically allocated buffer. Output that does
+// not fit is dropped and reported by overflow().
+template <size_t N>
+class PrintBuffer : public Print
+{
+public:
+  PrintBuffer() : _length(0), _overflow(false) { _buffer[0] = 0; }
+
+  size_t write(uint8_t data) override
+  {
+    return write(&data, 1);
+  }
+
+  size_t write(const uint8_t *data, size_t size) override
+  {
+    if (_length + size >= N)
+    {
+      _overflow = true;
+      size = N - 1 - _length;
+    }
+    memcpy(_buffer + _length, data, size);
+    _length += size;
+    _buffer[_length] = 0;
+    return size;
+  }
+
+  using Print::write;
+
+  void clear()
+  {
+    _length = 0;
+    _overflow = false;
+    _buffer[0] = 0;
+  }
+
+  const char *c_str() const { return _buffer; }
+  size_t length() const { return _length; }
+  bool overflow() const { return _overflow; }
+  static constexpr size_t capacity() { return N - 1; }
+
+private:
+  char _buffer[N];
+  size_t _length;
+  bool _overflow;
+};
+
+#endif
@@ -208,7 +208,7 @@ public:
     if ( !request->contentType().equalsIgnoreCase(JSON_MIMETYPE) )
       return false;
 
-    request->addInterestingHeader("ANY");
+    // the body is all the callback gets, no header is kept for it
     return true;
   }
 
@@ -74,12 +74,8 @@ size_t webSocketSendFrame(AsyncClient *client, bool final, uint8_t opcode, bool
 
   if(len > space) len = space;
 
-  uint8_t *buf = (uint8_t*)malloc(headLen);
-  if(buf == NULL){
-    //os_printf("could not malloc %u bytes for frame header\n", headLen);
-    return 0;
-  }
-
+  // the header is copied by lwIP, it does not need the heap
+  uint8_t buf[8];
   buf[0] = opcode & 0x0F;
   if(final)
     buf[0] |= 0x80;
@@ -94,12 +90,10 @@ size_t webSocketSendFrame(AsyncClient *client, bool final, uint8_t opcode, bool
     buf[1] |= 0x80;
     memcpy(buf + (headLen - 4), mbuf, 4);
   }
-  if(client->add((const char *)buf, headLen) != headLen){
+  if(client->add((const char *)buf, headLen, ASYNC_WRITE_FLAG_COPY) != headLen){
     //os_printf("error adding %lu header bytes\n", headLen);
-    free(buf);
     return 0;
   }
-  free(buf);
 
   if(len){
     if(len && mask){
@@ -486,6 +480,9 @@ AsyncWebSocketClient::AsyncWebSocketClient(AsyncWebServerRequest *request, Async
   _pstate = 0;
   _lastMessageTime = millis();
   _keepAlivePeriod = 0;
+  _lastProgress = _lastMessageTime;
+  _coalesced = 0;
+  _dropped = 0;
   _client->setRxTimeout(0);
   _client->onError([](void *r, AsyncClient* c, int8_t error){ (void)c; ((AsyncWebSocketClient*)(r))->_onError(error); }, this);
   _client->onAck([](void *r, AsyncClient* c, size_t len, uint32_t time){ (void)c; ((AsyncWebSocketClient*)(r))->_onAck(len, time); }, this);
@@ -506,6 +503,7 @@ AsyncWebSocketClient::~AsyncWebSocketClient(){
 
 void AsyncWebSocketClient::_onAck(size_t len, uint32_t time){
   _lastMessageTime = millis();
+  _lastProgress = _lastMessageTime;
   if(!_controlQueue.isEmpty()){
     auto head = _controlQueue.front();
     if(head->finished()){
@@ -527,6 +525,11 @@ void AsyncWebSocketClient::_onAck(size_t len, uint32_t time){
 }
 
 void AsyncWebSocketClient::_onPoll(){
+  if(WS_STALL_TIMEOUT && lag() > WS_STALL_TIMEOUT){
+    //nothing left the queue for too long, the peer is gone or too slow to keep
+    _client->close(true);
+    return;
+  }
   if(_client->canSend() && (!_controlQueue.isEmpty() || !_messageQueue.isEmpty())){
     _runQueue();
   } else if(_keepAlivePeriod > 0 && _controlQueue.isEmpty() && _messageQueue.isEmpty() && (millis() - _lastMessageTime) >= _keepAlivePeriod){
@@ -551,17 +554,28 @@ bool AsyncWebSocketClient::queueIsFull(){
   return false;
 }
 
-void AsyncWebSocketClient::_queueMessage(AsyncWebSocketMessage *dataMessage){
+uint32_t AsyncWebSocketClient::lag(){
+  return _messageQueue.isEmpty() ? 0 : millis() - _lastProgress;
+}
+
+void AsyncWebSocketClient::_queueMessage(AsyncWebSocketMessage *dataMessage, bool latest){
   if(dataMessage == NULL)
     return;
   if(_status != WS_CONNECTED){
     delete dataMessage;
     return;
   }
-  if(_messageQueue.length() >= WS_MAX_QUEUED_MESSAGES){
+  dataMessage->latest(latest);
+  if(latest && _messageQueue.replace_first([](AsyncWebSocketMessage *m){ return m->latest() && !m->started(); }, dataMessage)){
+    //a newer value supersedes the one still waiting, the queue does not grow
+    _coalesced++;
+  } else if(_messageQueue.length() >= WS_MAX_QUEUED_MESSAGES){
       ets_printf("ERROR: Too many messages queued\n");
+      _dropped++;
       delete dataMessage;
   } else {
+      if(_messageQueue.isEmpty())
+        _lastProgress = millis();
       _messageQueue.add(dataMessage);
   }
   if(_client->canSend())
@@ -802,9 +816,9 @@ void AsyncWebSocketClient::text(const __FlashStringHelper *data){
     free(message);
   }
 }
-void AsyncWebSocketClient::text(AsyncWebSocketMessageBuffer * buffer)
+void AsyncWebSocketClient::text(AsyncWebSocketMessageBuffer * buffer, bool latest)
 {
-  _queueMessage(new AsyncWebSocketMultiMessage(buffer));
+  _queueMessage(new AsyncWebSocketMultiMessage(buffer), latest);
 }
 
 void AsyncWebSocketClient::binary(const char * message, size_t len){
@@ -833,9 +847,9 @@ void AsyncWebSocketClient::binary(const __FlashStringHelper *data, size_t len){
   }
   
 }
-void AsyncWebSocketClient::binary(AsyncWebSocketMessageBuffer * buffer)
+void AsyncWebSocketClient::binary(AsyncWebSocketMessageBuffer * buffer, bool latest)
 {
-  _queueMessage(new AsyncWebSocketMultiMessage(buffer, WS_BINARY));
+  _queueMessage(new AsyncWebSocketMultiMessage(buffer, WS_BINARY), latest);
 }
 
 IPAddress AsyncWebSocketClient::remoteIP() {
@@ -1232,11 +1246,10 @@ void AsyncWebSocket::_cleanBuffers()
 {
   AsyncWebLockGuard l(_lock);
 
-  for(AsyncWebSocketMessageBuffer * c: _buffers){
-    if(c && c->canDelete()){
-        _buffers.remove(c);
-    }
-  }
+  // remove() frees the list node, the iterator must not step off it
+  while(_buffers.remove_first([](AsyncWebSocketMessageBuffer * c){
+    return c && c->canDelete();
+  }));
 }
 
 AsyncWebSocket::AsyncWebSocketClientLinkedList AsyncWebSocket::getClients() const {
@@ -40,6 +40,11 @@
 #endif
 #endif
 
+// ms a client may leave its queue untouched before it is dropped, 0 - never
+#ifndef WS_STALL_TIMEOUT
+#define WS_STALL_TIMEOUT 15000
+#endif
+
 #ifdef ESP32
 #define DEFAULT_MAX_WS_CLIENTS 8
 #else
@@ -113,9 +118,14 @@ class AsyncWebSocketMessage {
     uint8_t _opcode;
     bool _mask;
     AwsMessageStatus _status;
+    bool _latest;
   public:
-    AsyncWebSocketMessage():_opcode(WS_TEXT),_mask(false),_status(WS_MSG_ERROR){}
+    AsyncWebSocketMessage():_opcode(WS_TEXT),_mask(false),_status(WS_MSG_ERROR),_latest(false){}
     virtual ~AsyncWebSocketMessage(){}
+    //a latest-value message is replaced by the next one while it waits in the queue
+    void latest(bool latest){ _latest = latest; }
+    bool latest() const { return _latest; }
+    virtual bool started() const { return false; }
     virtual void ack(size_t len __attribute__((unused)), uint32_t time __attribute__((unused))){}
     virtual size_t send(AsyncClient *client __attribute__((unused))){ return 0; }
     virtual bool finished(){ return _status != WS_MSG_SENDING; }
@@ -134,6 +144,7 @@ public:
     AsyncWebSocketBasicMessage(uint8_t opcode=WS_TEXT, bool mask=false);
     virtual ~AsyncWebSocketBasicMessage() override;
     virtual bool betweenFrames() const override { return _acked == _ack; }
+    virtual bool started() const override { return _sent > 0; }
     virtual void ack(size_t len, uint32_t time) override ;
     virtual size_t send(AsyncClient *client) override ;
 };
@@ -150,6 +161,7 @@ public:
     AsyncWebSocketMultiMessage(AsyncWebSocketMessageBuffer * buffer, uint8_t opcode=WS_TEXT, bool mask=false); 
     virtual ~AsyncWebSocketMultiMessage() override;
     virtual bool betweenFrames() const override { return _acked == _ack; }
+    virtual bool started() const override { return _sent > 0; }
     virtual void ack(size_t len, uint32_t time) override ;
     virtual size_t send(AsyncClient *client) override ;
 };
@@ -170,7 +182,11 @@ class AsyncWebSocketClient {
     uint32_t _lastMessageTime;
     uint32_t _keepAlivePeriod;
 
-    void _queueMessage(AsyncWebSocketMessage *dataMessage);
+    uint32_t _lastProgress;  // last time the message queue moved
+    uint32_t _coalesced;
+    uint32_t _dropped;
+
+    void _queueMessage(AsyncWebSocketMessage *dataMessage, bool latest = false);
     void _queueControl(AsyncWebSocketControl *controlMessage);
     void _runQueue();
 
@@ -203,9 +219,15 @@ class AsyncWebSocketClient {
     }
 
     //data packets
-    void message(AsyncWebSocketMessage *message){ _queueMessage(message); }
+    void message(AsyncWebSocketMessage *message, bool latest = false){ _queueMessage(message, latest); }
     bool queueIsFull();
 
+    //queue metrics
+    size_t queueLength(){ return _messageQueue.length(); }
+    uint32_t lag();  //ms the queue has waited without progress, 0 when empty
+    uint32_t coalesced(){ return _coalesced; }  //latest-value messages replaced before they were sent
+    uint32_t dropped(){ return _dropped; }  //messages refused by a full queue
+
     size_t printf(const char *format, ...)  __attribute__ ((format (printf, 2, 3)));
 #ifndef ESP32
     size_t printf_P(PGM_P formatP, ...)  __attribute__ ((format (printf, 2, 3)));
@@ -216,7 +238,7 @@ class AsyncWebSocketClient {
     void text(char * message);
     void text(const String &message);
     void text(const __FlashStringHelper *data);
-    void text(AsyncWebSocketMessageBuffer *buffer); 
+    void text(AsyncWebSocketMessageBuffer *buffer, bool latest = false); 
 
     void binary(const char * message, size_t len);
     void binary(const char * message);
@@ -224,7 +246,7 @@ class AsyncWebSocketClient {
     void binary(char * message);
     void binary(const String &message);
     void binary(const __FlashStringHelper *data, size_t len);
-    void binary(AsyncWebSocketMessageBuffer *buffer); 
+    void binary(AsyncWebSocketMessageBuffer *buffer, bool latest = false); 
 
     bool canSend() { return _messageQueue.length() < WS_MAX_QUEUED_MESSAGES; }
 
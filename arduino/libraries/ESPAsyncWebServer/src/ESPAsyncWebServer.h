@@ -46,6 +46,16 @@
 
 #define DEBUGF(...) //Serial.printf(__VA_ARGS__)
 
+#ifndef ASYNC_KEEPALIVE_TIMEOUT
+#define ASYNC_KEEPALIVE_TIMEOUT 5        //seconds an idle persistent connection is kept open
+#endif
+#ifndef ASYNC_KEEPALIVE_MAX_REQUESTS
+#define ASYNC_KEEPALIVE_MAX_REQUESTS 32  //requests served on one connection
+#endif
+#ifndef ASYNC_PIPELINE_MAX
+#define ASYNC_PIPELINE_MAX 1024          //bytes of pipelined requests buffered while responding
+#endif
+
 class AsyncWebServer;
 class AsyncWebServerRequest;
 class AsyncWebServerResponse;
@@ -145,9 +155,14 @@ class AsyncWebServerRequest {
     ArDisconnectHandler _onDisconnectfn;
 
     String _temp;
+    String _rawHeaders;     //"name:value\n" lines, until the handler says which it wants
     uint8_t _parseState;
+    bool _started;          //the first bytes of the request arrived
 
     uint8_t _version;
+    bool _keepAlive;
+    uint8_t _requests;      //requests served on this connection before this one
+    String _pipelined;      //the next requests, received before this one was answered
     WebRequestMethodComposite _method;
     String _url;
     String _host;
@@ -155,7 +170,7 @@ class AsyncWebServerRequest {
     String _boundary;
     String _authorization;
     RequestedConnectionType _reqconntype;
-    void _removeNotInterestingHeaders();
+    void _addInterestingHeaders();
     bool _isDigest;
     bool _isMultipart;
     bool _isPlainPost;
@@ -185,14 +200,16 @@ class AsyncWebServerRequest {
     void _onTimeout(uint32_t time);
     void _onDisconnect();
     void _onData(void *buf, size_t len);
+    void _onResponseEnd();
 
     void _addParam(AsyncWebParameter*);
     void _addPathParam(const char *param);
 
-    bool _parseReqHead();
-    bool _parseReqHeader();
-    void _parseLine();
-    void _parsePlainPostChar(uint8_t data);
+    bool _parseReqHead(char *line, size_t len);
+    bool _parseReqHeader(char *line, size_t len);
+    void _parseLine(char *line, size_t len);
+    void _parsePlainPost(char *data, size_t len);
+    void _addPlainPostParam();
     void _parseMultipartPostByte(uint8_t data, bool last);
     void _addGetParams(const String& params);
 
@@ -368,6 +385,7 @@ class AsyncWebServerResponse {
     size_t _ackedLength;
     size_t _writtenLength;
     WebResponseState _state;
+    bool _keepAlive;
     const char* _responseCodeToString(int code);
 
   public:
@@ -378,6 +396,8 @@ class AsyncWebServerResponse {
     virtual void setContentType(const String& type);
     virtual void addHeader(const String& name, const String& value);
     virtual String _assembleHead(uint8_t version);
+    void _setKeepAlive(bool keepAlive);
+    bool _isKeepAlive() const { return _keepAlive; }
     virtual bool _started() const;
     virtual bool _finished() const;
     virtual bool _failed() const;
@@ -403,7 +423,7 @@ class AsyncWebServer {
 
   public:
     AsyncWebServer(uint16_t port);
-    ~AsyncWebServer();
+    virtual ~AsyncWebServer();
 
     void begin();
     void end();
@@ -434,6 +454,9 @@ class AsyncWebServer {
     void reset(); //remove all writers and handlers, with onNotFound/onFileUpload/onRequestBody 
   
     void _handleDisconnect(AsyncWebServerRequest *request);
+    virtual AsyncWebServerRequest* _handleClient(AsyncClient *client); //a connection was accepted, returns its request or NULL
+    virtual void _handleRequestStart(AsyncWebServerRequest *request){ (void)request; } //the first bytes of a request arrived
+    virtual void _handleRequestEnd(AsyncWebServerRequest *request){ (void)request; } //a started request is being deleted
     void _attachHandler(AsyncWebServerRequest *request);
     void _rewriteRequest(AsyncWebServerRequest *request);
 };
@@ -158,6 +158,19 @@ class LinkedList {
       return false;
     }
     
+    bool replace_first(Predicate predicate, const T& t){
+      for(auto it = _root; it; it = it->next){
+        if(predicate(it->value())){
+          if (_onRemove) {
+            _onRemove(it->value());
+          }
+          it->value() = t;
+          return true;
+        }
+      }
+      return false;
+    }
+
     void free(){
       while(_root != nullptr){
         auto it = _root;
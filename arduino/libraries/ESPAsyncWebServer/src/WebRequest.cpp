@@ -28,6 +28,51 @@
 
 static const String SharedEmptyString = String();
 
+// appends len bytes of data to s in one go, data[len - 1] is restored after
+static void concatSpan(String& s, char *data, size_t len){
+  if(!len)
+    return;
+  char last = data[len-1];
+  data[len-1] = 0;
+  s.reserve(s.length() + len);
+  // concat() of a C string stops at a NUL, a binary body has them inside
+  char *end = data + len - 1;
+  while(data < end){
+    size_t n = strlen(data);
+    s.concat(data);
+    data += n;
+    if(data < end){
+      s.concat('\0');
+      data++;
+    }
+  }
+  s.concat(last);
+  end[0] = last;
+}
+
+// frees the buffer of s, assigning String() to it only empties it
+static void release(String& s){
+  s = (const char*)NULL;
+}
+
+static bool spanEquals(const char *data, size_t len, const char *str){
+  return strlen(str) == len && strncasecmp(data, str, len) == 0;
+}
+
+static bool spanStartsWith(const char *data, size_t len, const char *str){
+  size_t n = strlen(str);
+  return n <= len && strncasecmp(data, str, n) == 0;
+}
+
+static bool spanContains(const char *data, size_t len, const char *str){
+  size_t n = strlen(str);
+  for(size_t i = 0; i + n <= len; i++){
+    if(strncasecmp(data + i, str, n) == 0)
+      return true;
+  }
+  return false;
+}
+
 #define __is_param_char(c) ((c) && ((c) != '{') && ((c) != '[') && ((c) != '&') && ((c) != '='))
 
 enum { PARSE_REQ_START, PARSE_REQ_HEADERS, PARSE_REQ_BODY, PARSE_REQ_END, PARSE_REQ_FAIL };
@@ -38,8 +83,13 @@ AsyncWebServerRequest::AsyncWebServerRequest(AsyncWebServer* s, AsyncClient* c)
   , _handler(NULL)
   , _response(NULL)
   , _temp()
+  , _rawHeaders()
   , _parseState(0)
+  , _started(false)
   , _version(0)
+  , _keepAlive(false)
+  , _requests(0)
+  , _pipelined()
   , _method(HTTP_ANY)
   , _url()
   , _host()
@@ -78,6 +128,9 @@ AsyncWebServerRequest::AsyncWebServerRequest(AsyncWebServer* s, AsyncClient* c)
 }
 
 AsyncWebServerRequest::~AsyncWebServerRequest(){
+  if(_started)
+    _server->_handleRequestEnd(this);
+
   _headers.free();
 
   _params.free();
@@ -99,36 +152,53 @@ AsyncWebServerRequest::~AsyncWebServerRequest(){
 }
 
 void AsyncWebServerRequest::_onData(void *buf, size_t len){
-  size_t i = 0;
+  // a kept alive connection waits in a request that has not started yet
+  if(!_started){
+    _started = true;
+    _server->_handleRequestStart(this);
+  }
+
   while (true) {
 
   if(_parseState < PARSE_REQ_BODY){
-    // Find new line in buf
+    // Lines are parsed where they were received, only a line split over
+    // packets is collected in _temp
     char *str = (char*)buf;
-    for (i = 0; i < len; i++) {
-      if (str[i] == '\n') {
-        break;
-      }
+    char *eol = (char*)memchr(str, '\n', len);
+    if (eol == NULL) {
+      concatSpan(_temp, str, len);
+      break;
     }
-    if (i == len) { // No new line, just add the buffer in _temp
-      char ch = str[len-1];
-      str[len-1] = 0;
-      _temp.reserve(_temp.length()+len);
-      _temp.concat(str);
-      _temp.concat(ch);
-    } else { // Found new line - extract it and parse
-      str[i] = 0; // Terminate the string at the end of the line.
-      _temp.concat(str);
-      _temp.trim();
-      _parseLine();
-      if (++i < len) {
-        // Still have more buffer to process
-        buf = str+i;
-        len-= i;
-        continue;
-      }
+
+    if (_parseState == PARSE_REQ_HEADERS && !_rawHeaders.length() && !_temp.length()) {
+      // One buffer for the header lines of this packet, instead of growing
+      // it by a reallocation per header
+      char *blank = (char*)memmem(str, len, "\r\n\r\n", 4);
+      _rawHeaders.reserve(blank ? blank - str : len);
+    }
+
+    size_t lineLen = eol - str;
+    if (_temp.length()) {
+      concatSpan(_temp, str, lineLen);
+      _parseLine((char*)_temp.c_str(), _temp.length());
+    } else {
+      _parseLine(str, lineLen);
+    }
+    _temp = String();
+
+    if (++lineLen < len) {
+      // Still have more buffer to process
+      buf = str + lineLen;
+      len -= lineLen;
+      continue;
     }
   } else if(_parseState == PARSE_REQ_BODY){
+    // Bytes past the body belong to the next, pipelined request
+    size_t rest = 0;
+    if(len > _contentLength - _parsedLength){
+      rest = len - (_contentLength - _parsedLength);
+      len -= rest;
+    }
     // A handler should be already attached at this point in _parseLine function.
     // If handler does nothing (_onRequest is NULL), we don't need to really parse the body.
     const bool needParse = _handler && !_handler->isRequestHandlerTrivial();
@@ -158,11 +228,7 @@ void AsyncWebServerRequest::_onData(void *buf, size_t len){
         if(_handler) _handler->handleBody(this, (uint8_t*)buf, len, _parsedLength, _contentLength);
         _parsedLength += len;
       } else if(needParse) {
-        size_t i;
-        for(i=0; i<len; i++){
-          _parsedLength++;
-          _parsePlainPostChar(((uint8_t*)buf)[i]);
-        }
+        _parsePlainPost((char*)buf, len);
       } else {
         _parsedLength += len;
       }
@@ -173,18 +239,49 @@ void AsyncWebServerRequest::_onData(void *buf, size_t len){
       if(_handler) _handler->handleRequest(this);
       else send(501);
     }
+    if(rest){
+      buf = (uint8_t*)buf + len;
+      len = rest;
+      continue;
+    }
+  } else if(_parseState == PARSE_REQ_END && _keepAlive){
+    // Keep the next requests until this one is answered, the connection closes if they do not fit
+    if(_pipelined.length() + len > ASYNC_PIPELINE_MAX){
+      _keepAlive = false;
+      release(_pipelined);
+    } else {
+      concatSpan(_pipelined, (char*)buf, len);
+    }
   }
   break;
   }
 }
 
-void AsyncWebServerRequest::_removeNotInterestingHeaders(){
-  if (_interestingHeaders.containsIgnoreCase("ANY")) return; // nothing to do
-  for(const auto& header: _headers){
-      if(!_interestingHeaders.containsIgnoreCase(header->name().c_str())){
-        _headers.remove(header);
-      }
+// Creates the headers the handler asked for from the raw header lines
+void AsyncWebServerRequest::_addInterestingHeaders(){
+  const bool any = _interestingHeaders.containsIgnoreCase("ANY");
+  char *line = (char*)_rawHeaders.c_str();
+  char *end = line + _rawHeaders.length();
+  while(line < end){
+    char *eol = (char*)memchr(line, '\n', end - line);
+    char *colon = (char*)memchr(line, ':', eol - line);
+    size_t nameLen = colon - line;
+
+    bool interesting = any;
+    for(const auto& h: _interestingHeaders){
+      if(!interesting && spanEquals(line, nameLen, h.c_str()))
+        interesting = true;
+    }
+
+    if(interesting){
+      String name, value;
+      concatSpan(name, line, nameLen);
+      concatSpan(value, colon + 1, eol - colon - 1);
+      _headers.add(new AsyncWebHeader(name, value));
+    }
+    line = eol + 1;
   }
+  release(_rawHeaders);
 }
 
 void AsyncWebServerRequest::_onPoll(){
@@ -192,13 +289,22 @@ void AsyncWebServerRequest::_onPoll(){
   if(_response != NULL && _client != NULL && _client->canSend() && !_response->_finished()){
     _response->_ack(this, 0, 0);
   }
+  if(_response != NULL && _response->_finished() && _response->_isKeepAlive()){
+    _onResponseEnd();
+  }
 }
 
 void AsyncWebServerRequest::_onAck(size_t len, uint32_t time){
   //os_printf("a:%u:%u\n", len, time);
   if(_response != NULL){
     if(!_response->_finished()){
+      // a WebSocket upgrade hands the connection over and deletes this
+      // request in _ack(), it is never kept alive
+      bool keepAlive = _response->_isKeepAlive();
       _response->_ack(this, len, time);
+      if(keepAlive && _response->_finished()){
+        _onResponseEnd();
+      }
     } else {
       AsyncWebServerResponse* r = _response;
       _response = NULL;
@@ -214,9 +320,53 @@ void AsyncWebServerRequest::_onError(int8_t error){
 void AsyncWebServerRequest::_onTimeout(uint32_t time){
   (void)time;
   //os_printf("TIMEOUT: %u, state: %s\n", time, _client->stateToString());
+  _keepAlive = false;
   _client->close();
 }
 
+// The response of a persistent connection is fully acknowledged: the next
+// request on the connection gets a fresh request object, fed with whatever
+// was pipelined behind this one.
+void AsyncWebServerRequest::_onResponseEnd(){
+  if(!_keepAlive || _response->_failed()){
+    _response->_setKeepAlive(false);
+    _client->close();
+    return;
+  }
+
+  AsyncClient* c = _client;
+  AsyncWebServer* s = _server;
+  uint8_t requests = _requests + 1;
+  String pipelined = _pipelined;
+  _pipelined = String();
+
+  // to anyone holding it, this request is gone as if the client disconnected
+  if(_onDisconnectfn) {
+      _onDisconnectfn();
+    }
+
+  // nothing may call back into this request once it is deleted. Whatever
+  // _handleClient() makes of the client starts from a client that is only
+  // deleted when it disconnects
+  c->onError(NULL, NULL);
+  c->onAck(NULL, NULL);
+  c->onTimeout(NULL, NULL);
+  c->onData(NULL, NULL);
+  c->onPoll(NULL, NULL);
+  c->onDisconnect([](void *r, AsyncClient* c){ (void)r; delete c; }, NULL);
+  s->_handleDisconnect(this);
+
+  AsyncWebServerRequest *r = s->_handleClient(c);
+  if(r == NULL)
+    return;
+
+  r->_requests = requests;
+  c->setRxTimeout(ASYNC_KEEPALIVE_TIMEOUT);
+  if(pipelined.length()){
+    r->_onData((void*)pipelined.c_str(), pipelined.length());
+  }
+}
+
 void AsyncWebServerRequest::onDisconnect (ArDisconnectHandler fn){
     _onDisconnectfn=fn;
 }
@@ -251,119 +401,148 @@ void AsyncWebServerRequest::_addGetParams(const String& params){
   }
 }
 
-bool AsyncWebServerRequest::_parseReqHead(){
+bool AsyncWebServerRequest::_parseReqHead(char *line, size_t len){
   // Split the head into method, url and version
-  int index = _temp.indexOf(' ');
-  String m = _temp.substring(0, index);
-  index = _temp.indexOf(' ', index+1);
-  String u = _temp.substring(m.length()+1, index);
-  _temp = _temp.substring(index+1);
-
-  if(m == "GET"){
+  char *end = line + len;
+  char *space = (char*)memchr(line, ' ', len);
+  if(space == NULL)
+    space = end;
+  size_t methodLen = space - line;
+  char *url = space < end ? space + 1 : end;
+  space = (char*)memchr(url, ' ', end - url);
+  if(space == NULL)
+    space = end;
+  size_t urlLen = space - url;
+  char *version = space < end ? space + 1 : end;
+
+  if(spanEquals(line, methodLen, "GET")){
     _method = HTTP_GET;
-  } else if(m == "POST"){
+  } else if(spanEquals(line, methodLen, "POST")){
     _method = HTTP_POST;
-  } else if(m == "DELETE"){
+  } else if(spanEquals(line, methodLen, "DELETE")){
     _method = HTTP_DELETE;
-  } else if(m == "PUT"){
+  } else if(spanEquals(line, methodLen, "PUT")){
     _method = HTTP_PUT;
-  } else if(m == "PATCH"){
+  } else if(spanEquals(line, methodLen, "PATCH")){
     _method = HTTP_PATCH;
-  } else if(m == "HEAD"){
+  } else if(spanEquals(line, methodLen, "HEAD")){
     _method = HTTP_HEAD;
-  } else if(m == "OPTIONS"){
+  } else if(spanEquals(line, methodLen, "OPTIONS")){
     _method = HTTP_OPTIONS;
   }
 
-  String g = String();
-  index = u.indexOf('?');
-  if(index > 0){
-    g = u.substring(index +1);
-    u = u.substring(0, index);
+  String u, g;
+  char *query = (char*)memchr(url, '?', urlLen);
+  if(query != NULL && query > url){
+    concatSpan(u, url, query - url);
+    concatSpan(g, query + 1, urlLen - (query - url) - 1);
+  } else {
+    concatSpan(u, url, urlLen);
   }
   _url = urlDecode(u);
   _addGetParams(g);
 
-  if(!_temp.startsWith("HTTP/1.0"))
+  if(!spanStartsWith(version, end - version, "HTTP/1.0"))
     _version = 1;
+  _keepAlive = _version == 1;
 
-  _temp = String();
   return true;
 }
 
-bool strContains(String src, String find, bool mindcase = true) {
-  int pos=0, i=0;
-  const int slen = src.length();
-  const int flen = find.length();
+bool AsyncWebServerRequest::_parseReqHeader(char *line, size_t len){
+  char *colon = (char*)memchr(line, ':', len);
+  if(colon == NULL || colon == line)
+    return false;
 
-  if (slen < flen) return false;
-  while (pos <= (slen - flen)) {
-    for (i=0; i < flen; i++) {
-      if (mindcase) {
-        if (src[pos+i] != find[i]) i = flen + 1; // no match
-      } else if (tolower(src[pos+i]) != tolower(find[i])) i = flen + 1; // no match
-    }
-    if (i == flen) return true;
-    pos++;
+  char *name = line;
+  size_t nameLen = colon - line;
+  char *value = colon + 1;
+  size_t valueLen = len - nameLen - 1;
+  while(valueLen && isspace(*value)){
+    value++;
+    valueLen--;
   }
-  return false;
-}
 
-bool AsyncWebServerRequest::_parseReqHeader(){
-  int index = _temp.indexOf(':');
-  if(index){
-    String name = _temp.substring(0, index);
-    String value = _temp.substring(index + 2);
-    if(name.equalsIgnoreCase("Host")){
-      _host = value;
-    } else if(name.equalsIgnoreCase("Content-Type")){
-	  _contentType = value.substring(0, value.indexOf(';'));
-      if (value.startsWith("multipart/")){
-        _boundary = value.substring(value.indexOf('=')+1);
-        _boundary.replace("\"","");
-        _isMultipart = true;
-      }
-    } else if(name.equalsIgnoreCase("Content-Length")){
-      _contentLength = atoi(value.c_str());
-    } else if(name.equalsIgnoreCase("Expect") && value == "100-continue"){
-      _expectingContinue = true;
-    } else if(name.equalsIgnoreCase("Authorization")){
-      if(value.length() > 5 && value.substring(0,5).equalsIgnoreCase("Basic")){
-        _authorization = value.substring(6);
-      } else if(value.length() > 6 && value.substring(0,6).equalsIgnoreCase("Digest")){
-        _isDigest = true;
-        _authorization = value.substring(7);
-      }
-    } else {
-      if(name.equalsIgnoreCase("Upgrade") && value.equalsIgnoreCase("websocket")){
-        // WebSocket request can be uniquely identified by header: [Upgrade: websocket]
-        _reqconntype = RCT_WS;
-      } else {
-        if(name.equalsIgnoreCase("Accept") && strContains(value, "text/event-stream", false)){
-          // WebEvent request can be uniquely identified by header:  [Accept: text/event-stream]
-          _reqconntype = RCT_EVENT;
-        }
-      }
+  if(spanEquals(name, nameLen, "Host")){
+    _host = String();
+    concatSpan(_host, value, valueLen);
+  } else if(spanEquals(name, nameLen, "Content-Type")){
+    char *semicolon = (char*)memchr(value, ';', valueLen);
+    _contentType = String();
+    concatSpan(_contentType, value, semicolon ? semicolon - value : valueLen);
+    if(spanStartsWith(value, valueLen, "multipart/")){
+      char *equals = (char*)memchr(value, '=', valueLen);
+      _boundary = String();
+      if(equals)
+        concatSpan(_boundary, equals + 1, valueLen - (equals - value) - 1);
+      _boundary.replace("\"","");
+      _isMultipart = true;
     }
-    _headers.add(new AsyncWebHeader(name, value));
+  } else if(spanEquals(name, nameLen, "Content-Length")){
+    _contentLength = strtoul(value, NULL, 10);
+  } else if(spanEquals(name, nameLen, "Connection")){
+    if(spanContains(value, valueLen, "close")){
+      _keepAlive = false;
+    } else if(spanContains(value, valueLen, "keep-alive")){
+      _keepAlive = true;
+    }
+  } else if(spanEquals(name, nameLen, "Expect") && spanEquals(value, valueLen, "100-continue")){
+    _expectingContinue = true;
+  } else if(spanEquals(name, nameLen, "Authorization")){
+    if(valueLen > 5 && spanStartsWith(value, valueLen, "Basic")){
+      _authorization = String();
+      concatSpan(_authorization, value + 6, valueLen - 6);
+    } else if(valueLen > 6 && spanStartsWith(value, valueLen, "Digest")){
+      _isDigest = true;
+      _authorization = String();
+      concatSpan(_authorization, value + 7, valueLen - 7);
+    }
+  } else if(spanEquals(name, nameLen, "Upgrade") && spanEquals(value, valueLen, "websocket")){
+    // WebSocket request can be uniquely identified by header: [Upgrade: websocket]
+    _reqconntype = RCT_WS;
+  } else if(spanEquals(name, nameLen, "Accept") && spanContains(value, valueLen, "text/event-stream")){
+    // WebEvent request can be uniquely identified by header:  [Accept: text/event-stream]
+    _reqconntype = RCT_EVENT;
   }
-  _temp = String();
+
+  // kept raw until the handler tells which headers it wants
+  concatSpan(_rawHeaders, name, nameLen);
+  _rawHeaders.concat(':');
+  concatSpan(_rawHeaders, value, valueLen);
+  _rawHeaders.concat('\n');
   return true;
 }
 
-void AsyncWebServerRequest::_parsePlainPostChar(uint8_t data){
-  if(data && (char)data != '&')
-    _temp += (char)data;
-  if(!data || (char)data == '&' || _parsedLength == _contentLength){
-    String name = "body";
-    String value = _temp;
-    if(!_temp.startsWith("{") && !_temp.startsWith("[") && _temp.indexOf('=') > 0){
-      name = _temp.substring(0, _temp.indexOf('='));
-      value = _temp.substring(_temp.indexOf('=') + 1);
-    }
-    _addParam(new AsyncWebParameter(urlDecode(name), urlDecode(value), true));
-    _temp = String();
+void AsyncWebServerRequest::_parsePlainPost(char *data, size_t len){
+  while(len){
+    // up to the end of the parameter, or the end of the buffer
+    size_t n = 0;
+    while(n < len && data[n] && data[n] != '&')
+      n++;
+
+    concatSpan(_temp, data, n);
+    bool end = n < len;
+    if(end)
+      n++;
+    _parsedLength += n;
+
+    if(end || _parsedLength == _contentLength)
+      _addPlainPostParam();
+
+    data += n;
+    len -= n;
+  }
+}
+
+void AsyncWebServerRequest::_addPlainPostParam(){
+  String name = "body";
+  String value = _temp;
+  if(!_temp.startsWith("{") && !_temp.startsWith("[") && _temp.indexOf('=') > 0){
+    name = _temp.substring(0, _temp.indexOf('='));
+    value = _temp.substring(_temp.indexOf('=') + 1);
   }
+  _addParam(new AsyncWebParameter(urlDecode(name), urlDecode(value), true));
+  _temp = String();
 }
 
 void AsyncWebServerRequest::_handleUploadByte(uint8_t data, bool last){
@@ -551,24 +730,31 @@ void AsyncWebServerRequest::_parseMultipartPostByte(uint8_t data, bool last){
   }
 }
 
-void AsyncWebServerRequest::_parseLine(){
+void AsyncWebServerRequest::_parseLine(char *line, size_t len){
+  while(len && isspace(line[len-1]))
+    len--;
+  while(len && isspace(*line)){
+    line++;
+    len--;
+  }
+
   if(_parseState == PARSE_REQ_START){
-    if(!_temp.length()){
+    if(!len){
       _parseState = PARSE_REQ_FAIL;
       _client->close();
     } else {
-      _parseReqHead();
+      _parseReqHead(line, len);
       _parseState = PARSE_REQ_HEADERS;
     }
     return;
   }
 
   if(_parseState == PARSE_REQ_HEADERS){
-    if(!_temp.length()){
+    if(!len){
       //end of headers
       _server->_rewriteRequest(this);
       _server->_attachHandler(this);
-      _removeNotInterestingHeaders();
+      _addInterestingHeaders();
       if(_expectingContinue){
         const char * response = "HTTP/1.1 100 Continue\r\n\r\n";
         _client->write(response, os_strlen(response));
@@ -581,7 +767,7 @@ void AsyncWebServerRequest::_parseLine(){
         if(_handler) _handler->handleRequest(this);
         else send(501);
       }
-    } else _parseReqHeader();
+    } else _parseReqHeader(line, len);
   }
 }
 
@@ -722,6 +908,7 @@ void AsyncWebServerRequest::send(AsyncWebServerResponse *response){
   }
   else {
     _client->setRxTimeout(0);
+    _response->_setKeepAlive(_keepAlive && _parseState == PARSE_REQ_END && _requests + 1 < ASYNC_KEEPALIVE_MAX_REQUESTS);
     _response->_respond(this);
   }
 }
@@ -94,6 +94,7 @@ AsyncWebServerResponse::AsyncWebServerResponse()
   , _ackedLength(0)
   , _writtenLength(0)
   , _state(RESPONSE_SETUP)
+  , _keepAlive(false)
 {
   for(auto header: DefaultHeaders::Instance()) {
     _headers.add(new AsyncWebHeader(header->name(), header->value()));
@@ -145,17 +146,28 @@ String AsyncWebServerResponse::_assembleHead(uint8_t version){
     out.concat(buf);
   }
 
+  bool connection = false;
   for(const auto& header: _headers){
+    if(header->name().equalsIgnoreCase("Connection"))
+      connection = true;
     snprintf(buf, bufSize, "%s: %s\r\n", header->name().c_str(), header->value().c_str());
     out.concat(buf);
   }
   _headers.free();
 
+  //an explicit Connection header hands the connection over (upgrades, event streams)
+  if(connection)
+    _keepAlive = false;
+  else
+    out.concat(_keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n");
+
   out.concat("\r\n");
   _headLength = out.length();
   return out;
 }
 
+//only a response with a known end can leave the connection open
+void AsyncWebServerResponse::_setKeepAlive(bool keepAlive){ _keepAlive = keepAlive && (_sendContentLength || _chunked); }
 bool AsyncWebServerResponse::_started() const { return _state > RESPONSE_SETUP; }
 bool AsyncWebServerResponse::_finished() const { return _state > RESPONSE_WAIT_ACK; }
 bool AsyncWebServerResponse::_failed() const { return _state == RESPONSE_FAILED; }
@@ -175,7 +187,6 @@ AsyncBasicResponse::AsyncBasicResponse(int code, const String& contentType, cons
     if(!_contentType.length())
       _contentType = "text/plain";
   }
-  addHeader("Connection","close");
 }
 
 void AsyncBasicResponse::_respond(AsyncWebServerRequest *request){
@@ -255,7 +266,6 @@ AsyncAbstractResponse::AsyncAbstractResponse(AwsTemplateProcessor callback): _ca
 }
 
 void AsyncAbstractResponse::_respond(AsyncWebServerRequest *request){
-  addHeader("Connection","close");
   _head = _assembleHead(request->version());
   _state = RESPONSE_HEADERS;
   _ack(request, 0, 0);
@@ -41,16 +41,22 @@ AsyncWebServer::AsyncWebServer(uint16_t port)
   _server.onClient([](void *s, AsyncClient* c){
     if(c == NULL)
       return;
-    c->setRxTimeout(3);
-    AsyncWebServerRequest *r = new AsyncWebServerRequest((AsyncWebServer*)s, c);
-    if(r == NULL){
-      c->close(true);
-      c->free();
-      delete c;
-    }
+    ((AsyncWebServer*)s)->_handleClient(c);
   }, this);
 }
 
+AsyncWebServerRequest* AsyncWebServer::_handleClient(AsyncClient* c){
+  c->setRxTimeout(3);
+  AsyncWebServerRequest *r = new AsyncWebServerRequest(this, c);
+  if(r == NULL){
+    // a kept alive client calls this from its own callbacks, it is closed
+    // at its next poll and deleted once it disconnects
+    c->onDisconnect([](void *r, AsyncClient* c){ (void)r; delete c; }, NULL);
+    c->close();
+  }
+  return r;
+}
+
 AsyncWebServer::~AsyncWebServer(){
   reset();  
   end();
@@ -0,0 +1,76 @@
+//  StaticDelegate.h - fixed-size, allocation free callback used by TimeAlarms
+
+#ifndef StaticDelegate_h
+#define StaticDelegate_h
+
+#include <new>
+#include <stddef.h>
+#include <type_traits>
+
+// the GCC 4.8 toolchain of the ESP8266 core 2.x predates is_trivially_copyable
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ < 5
+#define STATIC_DELEGATE_TRIVIAL(T) (__has_trivial_copy(T) && __has_trivial_destructor(T))
+#else
+#define STATIC_DELEGATE_TRIVIAL(T) (std::is_trivially_copyable<T>::value)
+#endif
+
+// Drop-in replacement for std::function<void()> that never touches the heap.
+// It holds a free function, a bound member function (see bind()) or a small
+// trivially copyable functor, e.g. a lambda capturing a pointer or two.
+class StaticDelegate
+{
+public:
+  StaticDelegate() : stub(nullptr) {}
+  StaticDelegate(std::nullptr_t) : stub(nullptr) {}
+
+  template <typename Callable, typename = typename std::enable_if<!std::is_same<typename std::decay<Callable>::type, StaticDelegate>::value>::type>
+  StaticDelegate(Callable function) : stub(&invoke<Callable>)
+  {
+    // copies are plain byte copies and the callable is never destroyed
+    static_assert(STATIC_DELEGATE_TRIVIAL(Callable) && sizeof(Callable) <= sizeof(storage) && alignof(Callable) <= alignof(void *),
+                  "a StaticDelegate holds trivially copyable callables of up to two pointers, capture less or capture pointers");
+    new (storage) Callable(function);
+  }
+
+  // binds a member function without the std::bind allocation:
+  //   StaticDelegate::bind<SprinklerClass, &SprinklerClass::stop>(this)
+  template <typename T, void (T::*Method)()>
+  static StaticDelegate bind(T *object)
+  {
+    return StaticDelegate(MethodCall<T, Method>(object));
+  }
+
+  void operator()() const
+  {
+    if (stub) stub(storage);
+  }
+
+  explicit operator bool() const { return stub != nullptr; }
+  bool operator==(std::nullptr_t) const { return stub == nullptr; }
+  bool operator!=(std::nullptr_t) const { return stub != nullptr; }
+
+private:
+  typedef void (*Stub)(const void *storage);
+
+  template <typename T, void (T::*Method)()>
+  struct MethodCall
+  {
+    T *object;
+    MethodCall(T *obj) : object(obj) {}
+    void operator()() const { (object->*Method)(); }
+  };
+
+  template <typename Callable>
+  static void invoke(const void *storage)
+  {
+    (*static_cast<Callable *>(const_cast<void *>(storage)))();
+  }
+
+  union {
+    void *align;
+    char storage[2 * sizeof(void *)];
+  };
+  Stub stub;
+};
+
+#endif /* StaticDelegate_h */
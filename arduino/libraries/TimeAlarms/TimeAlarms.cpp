@@ -84,7 +84,9 @@ void AlarmClass::updateNextTrigger()
 TimeAlarmsClass::TimeAlarmsClass()
 {
   isServicing = false;
-  for(uint8_t id = 0; id < dtNBR_ALARMS; id++) {
+  heapSize = 0;
+  for(AlarmID_t id = 0; id < dtNBR_ALARMS; id++) {
+    heapPos[id] = dtINVALID_ALARM_ID;
     free(id);   // ensure all Alarms are cleared and available for allocation
   }
 }
@@ -101,6 +103,12 @@ void TimeAlarmsClass::enable(AlarmID_t ID)
     } else {
       Alarm[ID].Mode.isEnabled = false;
     }
+
+    if (Alarm[ID].Mode.isEnabled) {
+      heapUpdate(ID);
+    } else {
+      heapRemove(ID);
+    }
   }
 }
 
@@ -108,6 +116,7 @@ void TimeAlarmsClass::disable(AlarmID_t ID)
 {
   if (isAllocated(ID)) {
     Alarm[ID].Mode.isEnabled = false;
+    heapRemove(ID);
   }
 }
 
@@ -144,6 +153,7 @@ dtAlarmPeriod_t TimeAlarmsClass::readType(AlarmID_t ID)
 void TimeAlarmsClass::free(AlarmID_t ID)
 {
   if (isAllocated(ID)) {
+    heapRemove(ID);
     Alarm[ID].Mode.isEnabled = false;
     Alarm[ID].Mode.alarmType = dtNotAllocated;
     Alarm[ID].onTickHandler = nullptr;
@@ -153,10 +163,10 @@ void TimeAlarmsClass::free(AlarmID_t ID)
 }
 
 // returns the number of allocated timers
-uint8_t TimeAlarmsClass::count()
+AlarmID_t TimeAlarmsClass::count()
 {
-  uint8_t c = 0;
-  for(uint8_t id = 0; id < dtNBR_ALARMS; id++) {
+  AlarmID_t c = 0;
+  for(AlarmID_t id = 0; id < dtNBR_ALARMS; id++) {
     if (isAllocated(id)) c++;
   }
   return c;
@@ -233,36 +243,101 @@ void TimeAlarmsClass::serviceAlarms()
 {
   if (!isServicing) {
     isServicing = true;
-    for (servicedAlarmId = 0; servicedAlarmId < dtNBR_ALARMS; servicedAlarmId++) {
-      if (Alarm[servicedAlarmId].Mode.isEnabled && (now() >= Alarm[servicedAlarmId].nextTrigger)) {
-        OnTick_t TickHandler = Alarm[servicedAlarmId].onTickHandler;
-        if (Alarm[servicedAlarmId].Mode.isOneShot) {
-          free(servicedAlarmId);  // free the ID if mode is OnShot
+    time_t time = now();
+    // only the heap top is inspected; every alarm is serviced at most once per pass
+    for (unsigned int serviced = 0; heapSize > 0 && serviced < dtNBR_ALARMS; serviced++) {
+      servicedAlarmId = heap[0];
+      if (Alarm[servicedAlarmId].nextTrigger > time) {
+        break;
+      }
+      OnTick_t TickHandler = Alarm[servicedAlarmId].onTickHandler;
+      if (Alarm[servicedAlarmId].Mode.isOneShot) {
+        free(servicedAlarmId);  // free the ID if mode is OnShot
+      } else {
+        Alarm[servicedAlarmId].updateNextTrigger();
+        if (Alarm[servicedAlarmId].Mode.isEnabled) {
+          heapUpdate(servicedAlarmId);
         } else {
-          Alarm[servicedAlarmId].updateNextTrigger();
-        }
-        if (TickHandler!= nullptr) {
-          TickHandler();     // call the handler
+          heapRemove(servicedAlarmId);
         }
       }
+      if (TickHandler!= nullptr) {
+        TickHandler();     // call the handler
+      }
     }
     isServicing = false;
   }
 }
 
-// returns the absolute time of the next scheduled alarm, or 0 if none
+// returns the absolute time of the next enabled alarm, or 0 if none
 time_t TimeAlarmsClass::getNextTrigger()
 {
-  time_t nextTrigger = (time_t)0xffffffff;  // the max time value
+  return heapSize ? Alarm[heap[0]].nextTrigger : 0;
+}
 
-  for (uint8_t id = 0; id < dtNBR_ALARMS; id++) {
-    if (isAllocated(id)) {
-      if (Alarm[id].nextTrigger <  nextTrigger) {
-        nextTrigger = Alarm[id].nextTrigger;
-      }
+void TimeAlarmsClass::heapSwap(AlarmID_t a, AlarmID_t b)
+{
+  AlarmID_t id = heap[a];
+  heap[a] = heap[b];
+  heap[b] = id;
+  heapPos[heap[a]] = a;
+  heapPos[heap[b]] = b;
+}
+
+void TimeAlarmsClass::heapUp(AlarmID_t pos)
+{
+  while (pos > 0) {
+    AlarmID_t parent = (pos - 1) / 2;
+    if (Alarm[heap[pos]].nextTrigger >= Alarm[heap[parent]].nextTrigger) {
+      break;
+    }
+    heapSwap(pos, parent);
+    pos = parent;
+  }
+}
+
+void TimeAlarmsClass::heapDown(AlarmID_t pos)
+{
+  while (true) {
+    unsigned int child = 2 * (unsigned int)pos + 1;
+    if (child >= heapSize) {
+      break;
     }
+    if (child + 1 < heapSize && Alarm[heap[child + 1]].nextTrigger < Alarm[heap[child]].nextTrigger) {
+      child++;
+    }
+    if (Alarm[heap[pos]].nextTrigger <= Alarm[heap[child]].nextTrigger) {
+      break;
+    }
+    heapSwap(pos, child);
+    pos = child;
+  }
+}
+
+void TimeAlarmsClass::heapUpdate(AlarmID_t ID)
+{
+  if (heapPos[ID] == dtINVALID_ALARM_ID) {
+    heap[heapSize] = ID;
+    heapPos[ID] = heapSize++;
+  }
+  heapUp(heapPos[ID]);
+  heapDown(heapPos[ID]);
+}
+
+void TimeAlarmsClass::heapRemove(AlarmID_t ID)
+{
+  AlarmID_t pos = heapPos[ID];
+  if (pos == dtINVALID_ALARM_ID) {
+    return;
+  }
+  AlarmID_t last = --heapSize;
+  if (pos != last) {
+    heapSwap(pos, last);
+    AlarmID_t moved = heap[pos];
+    heapUp(pos);
+    heapDown(heapPos[moved]);
   }
-  return nextTrigger == (time_t)0xffffffff ? 0 : nextTrigger;
+  heapPos[ID] = dtINVALID_ALARM_ID;
 }
 
 // attempt to create an alarm and return true if successful
@@ -270,7 +345,7 @@ AlarmID_t TimeAlarmsClass::create(time_t value, OnTick_t onTickHandler, uint8_t
 {
   if ( ! ( (dtIsAlarm(alarmType) && now() < SECS_PER_YEAR) || (dtUseAbsoluteValue(alarmType) && (value == 0)) ) ) {
     // only create alarm ids if the time is at least Jan 1 1971
-    for (uint8_t id = 0; id < dtNBR_ALARMS; id++) {
+    for (AlarmID_t id = 0; id < dtNBR_ALARMS; id++) {
       if (Alarm[id].Mode.alarmType == dtNotAllocated) {
         // here if there is an Alarm id that is not allocated
         Alarm[id].onTickHandler = onTickHandler;
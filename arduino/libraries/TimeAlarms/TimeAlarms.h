@@ -3,15 +3,18 @@
 #ifndef TimeAlarms_h
 #define TimeAlarms_h
 
-#include <functional>
 #include <Arduino.h>
 #include "TimeLib.h"
+#include "StaticDelegate.h"
 
+// the pool size can be overridden with a build flag, e.g. -DdtNBR_ALARMS=64
+#ifndef dtNBR_ALARMS
 #if defined(__AVR__)
-#define dtNBR_ALARMS 6   // max is 255
+#define dtNBR_ALARMS 6   // max is 65534
 #else
 #define dtNBR_ALARMS 12  // assume non-AVR has more memory
 #endif
+#endif
 
 #define USE_SPECIALIST_METHODS  // define this for testing
 
@@ -46,14 +49,19 @@ typedef enum {
 #define dtIsAlarm(_type_)  (_type_ >= dtExplicitAlarm && _type_ < dtLastAlarmType)
 #define dtUseAbsoluteValue(_type_)  (_type_ == dtTimer || _type_ == dtExplicitAlarm)
 
+#if dtNBR_ALARMS > 254
+typedef uint16_t AlarmID_t;
+#define dtINVALID_ALARM_ID 0xFFFF
+#else
 typedef uint8_t AlarmID_t;
+#define dtINVALID_ALARM_ID 255
+#endif
 typedef AlarmID_t AlarmId;  // Arduino friendly name
 
-#define dtINVALID_ALARM_ID 255
 #define dtINVALID_TIME     (time_t)(-1)
 #define AlarmHMS(_hr_, _min_, _sec_) (_hr_ * SECS_PER_HOUR + _min_ * SECS_PER_MIN + _sec_)
 
-typedef std::function<void()> OnTick_t;  // better alarm callback function typedef
+typedef StaticDelegate OnTick_t;  // allocation free alarm callback, accepts functions, small lambdas and StaticDelegate::bind()
 //typedef void (*OnTick_t)();  // alarm callback function typedef
 
 // class defining an alarm instance, only used by dtAlarmsClass
@@ -75,9 +83,19 @@ private:
   AlarmClass Alarm[dtNBR_ALARMS];
   void serviceAlarms();
   uint8_t isServicing;
-  uint8_t servicedAlarmId; // the alarm currently being serviced
+  AlarmID_t servicedAlarmId; // the alarm currently being serviced
   AlarmID_t create(time_t value, OnTick_t onTickHandler, uint8_t isOneShot, dtAlarmPeriod_t alarmType);
 
+  // enabled alarms kept as a binary min-heap ordered by nextTrigger
+  AlarmID_t heap[dtNBR_ALARMS];
+  AlarmID_t heapPos[dtNBR_ALARMS];  // position of each alarm in the heap, dtINVALID_ALARM_ID if not queued
+  AlarmID_t heapSize;
+  void heapSwap(AlarmID_t a, AlarmID_t b);
+  void heapUp(AlarmID_t pos);
+  void heapDown(AlarmID_t pos);
+  void heapUpdate(AlarmID_t ID);            // queue the alarm or restore heap order after its trigger changed
+  void heapRemove(AlarmID_t ID);
+
 public:
   TimeAlarmsClass();
   // functions to create alarms and timers
@@ -159,8 +177,8 @@ public:
 #ifndef USE_SPECIALIST_METHODS
 private:  // the following methods are for testing and are not documented as part of the standard library
 #endif
-  uint8_t count();                          // returns the number of allocated timers
-  time_t getNextTrigger();                  // returns the time of the next scheduled alarm
+  AlarmID_t count();                        // returns the number of allocated timers
+  time_t getNextTrigger();                  // returns the time of the next enabled alarm
   bool isAllocated(AlarmID_t ID);           // returns true if this id is allocated
   bool isAlarm(AlarmID_t ID);               // returns true if id is for a time based alarm, false if its a timer or not allocated
 };
@@ -4,38 +4,54 @@
 #include <Arduino.h>
 #include <Ticker.h>
 #include <Time.h>
+// only for the OnTick_t handler type and AlarmHMS, the timeline below
+// replaced the alarm service, nothing calls Alarm.delay() or serviceAlarms()
 #include <TimeAlarms.h>
 
+#define SCHEDULE_MAX_EVENTS 14  // everyday program (7) + one program per day (7)
+#define SCHEDULE_GRACE_PERIOD 60  // seconds an event may be late and still fire
+#define SCHEDULE_JSON_SIZE 64  // { "enabled": 1, "d": 4294967295, "t": "23:59" }
+#define SCHEDULE_WEEK_JSON_SIZE (8 * (SCHEDULE_JSON_SIZE + 12))
+
 class ScheduleClass
 {
 protected:
   unsigned int Duration;
-  AlarmID_t AlarmID;
+  bool Enabled;
   OnTick_t OnTick;
   time_t Time;
+  ScheduleClass *Parent;
+
+  virtual void changed()
+  {
+    if (Parent)
+    {
+      Parent->changed();
+    }
+  }
 
 public:
-  ScheduleClass()
-      : Time(0), Duration(0), AlarmID(dtINVALID_ALARM_ID)
+  ScheduleClass(ScheduleClass *parent = nullptr)
+      : Duration(0), Enabled(false), Time(0), Parent(parent)
   {
   }
 
-  void set(OnTick_t func) 
+  void set(OnTick_t func)
   {
     OnTick = func;
   }
 
   bool isEnabled()
   {
-    return Alarm.isAllocated(AlarmID);
+    return Enabled;
   }
 
   void disable()
   {
-    if (Alarm.isAllocated(AlarmID))
+    if (Enabled)
     {
-      Alarm.free(AlarmID);
-      AlarmID = dtINVALID_ALARM_ID;
+      Enabled = false;
+      changed();
     }
   }
 
@@ -80,7 +96,7 @@ public:
   virtual void setMinute(int value)
   {
     disable();
-    
+
     tmElements_t te;
     breakTime(Time ? Time : now(), te);
     te.Minute = value;
@@ -91,9 +107,26 @@ public:
     Time = makeTime(te);
   }
 
-  virtual String toJSON()
+  virtual size_t toJSON(Print &out)
+  {
+    size_t n = out.print("{ ");
+    n += fieldsToJSON(out);
+    n += out.print(" }");
+    return n;
+  }
+
+  size_t fieldsToJSON(Print &out)
   {
-    return "{ \"AlarmID\": " + (String)AlarmID + ", \"enabled\": " + (String)Alarm.isAllocated(AlarmID) + ", \"d\": " + (String)Duration + ", \"t\": \"" + (String)hour(Time) + ":" + (String)minute(Time) + "\" }";
+    size_t n = out.print("\"enabled\": ");
+    n += out.print(Enabled ? '1' : '0');
+    n += out.print(", \"d\": ");
+    n += out.print(Duration);
+    n += out.print(", \"t\": \"");
+    n += out.print(hour(Time));
+    n += out.print(':');
+    n += out.print(minute(Time));
+    n += out.print('"');
+    return n;
   }
 
   friend class ScheduleDay;
@@ -106,24 +139,113 @@ protected:
   timeDayOfWeek_t Day;
 
 public:
-  ScheduleDay(timeDayOfWeek_t day)
-      : ScheduleClass(),
+  ScheduleDay(ScheduleClass *parent, timeDayOfWeek_t day)
+      : ScheduleClass(parent),
         Day(day)
   {
   }
 
   bool enable() override
   {
-    disable();
-
-    AlarmID = Alarm.alarmRepeat(Day, hour(Time), minute(Time), 0, OnTick);
+    if (!Enabled)
+    {
+      Enabled = true;
+      changed();
+    }
 
-    return Alarm.isAllocated(AlarmID);
+    return Enabled;
   }
 };
 
+// A program start compiled into the weekly timeline.
+struct ScheduleEvent
+{
+  uint32_t second;  // seconds since Sunday 00:00
+  ScheduleClass *program;
+};
+
 class ScheduleWeek : public ScheduleClass
 {
+private:
+  ScheduleEvent Events[SCHEDULE_MAX_EVENTS];
+  uint8_t EventCount;
+  uint8_t Cursor;
+  time_t WeekStart;
+  time_t NextTrigger;
+  bool Dirty;
+
+  void changed() override
+  {
+    Dirty = true;
+  }
+
+  void add(ScheduleClass &program, uint32_t second)
+  {
+    if (EventCount >= SCHEDULE_MAX_EVENTS)
+      return;
+
+    // keep the timeline sorted, it only holds a handful of events
+    uint8_t i = EventCount++;
+    for (; i > 0 && Events[i - 1].second > second; i--)
+    {
+      Events[i] = Events[i - 1];
+    }
+    Events[i].second = second;
+    Events[i].program = &program;
+  }
+
+  void compile()
+  {
+    EventCount = 0;
+
+    uint32_t daySecond = AlarmHMS(hour(Time), minute(Time), 0);
+    for (int day = (int)dowSunday; day <= (int)dowSaturday; day++)
+    {
+      if (Enabled)
+      {
+        add(*this, (day - 1) * SECS_PER_DAY + daySecond);
+      }
+
+      ScheduleClass &skd = get((timeDayOfWeek_t)day);
+      if (skd.Enabled)
+      {
+        add(skd, (day - 1) * SECS_PER_DAY + AlarmHMS(hour(skd.Time), minute(skd.Time), 0));
+      }
+    }
+
+    Dirty = false;
+  }
+
+  void seek(time_t time)
+  {
+    WeekStart = previousSunday(time);
+    uint32_t second = time - WeekStart;
+
+    Cursor = 0;
+    while (Cursor < EventCount && Events[Cursor].second <= second)
+    {
+      Cursor++;
+    }
+
+    if (Cursor == EventCount)
+    {
+      Cursor = 0;
+      WeekStart += SECS_PER_WEEK;
+    }
+
+    NextTrigger = EventCount ? WeekStart + Events[Cursor].second : 0;
+  }
+
+  void advance()
+  {
+    if (++Cursor == EventCount)
+    {
+      Cursor = 0;
+      WeekStart += SECS_PER_WEEK;
+    }
+
+    NextTrigger = WeekStart + Events[Cursor].second;
+  }
 
 public:
   ScheduleDay Mon;
@@ -136,33 +258,25 @@ public:
 
   ScheduleWeek()
       : ScheduleClass(),
-        Mon(dowMonday),
-        Tue(dowTuesday),
-        Wed(dowWednesday),
-        Thu(dowThursday),
-        Fri(dowFriday),
-        Sat(dowSaturday),
-        Sun(dowSunday)
+        EventCount(0),
+        Cursor(0),
+        WeekStart(0),
+        NextTrigger(0),
+        Dirty(true),
+        Mon(this, dowMonday),
+        Tue(this, dowTuesday),
+        Wed(this, dowWednesday),
+        Thu(this, dowThursday),
+        Fri(this, dowFriday),
+        Sat(this, dowSaturday),
+        Sun(this, dowSunday)
   {
   }
 
-  void attach() 
+  // re-seeks the timeline, call it whenever the clock was set
+  void attach()
   {
-    if (!Duration)
-    {
-      for (int day = (int)dowSunday; day <= (int)dowSaturday; day++)
-      {
-        ScheduleClass &skd = get((timeDayOfWeek_t)day);
-        if (skd.Duration) {
-          skd.enable();
-        }
-      }
-    }
-    else
-    {
-      disable();
-      AlarmID = Alarm.alarmRepeat(hour(Time), minute(Time), 0, OnTick);
-    }
+    Dirty = true;
   }
 
   bool enable() override
@@ -176,11 +290,66 @@ public:
       skd.Duration = Duration;
     }
 
-    disable();
+    Enabled = true;
+    changed();
 
-    AlarmID = Alarm.alarmRepeat(hour(Time), minute(Time), 0, OnTick);
+    return Enabled;
+  }
 
-    return Alarm.isAllocated(AlarmID);
+  // fires the program at the cursor once it is due, call it from loop()
+  void handle()
+  {
+    handle(now());
+  }
+
+  // same as handle() at the given time, lets a host build step the timeline
+  // with a virtual clock instead of waiting for real days
+  void handle(time_t time)
+  {
+    if (time < SECS_PER_YEAR)
+      return;  // the clock is not set yet
+
+    if (Dirty)
+    {
+      compile();
+      seek(time);
+    }
+
+    while (EventCount && time >= NextTrigger)
+    {
+      ScheduleClass *program = Events[Cursor].program;
+      bool late = (time - NextTrigger) > SCHEDULE_GRACE_PERIOD;
+
+      advance();
+
+      if (!late && program->OnTick)
+      {
+        program->OnTick();
+      }
+
+      if (Dirty)
+        break;  // the handler changed the schedule, re-seek on the next pass
+    }
+  }
+
+  time_t getNextTrigger()
+  {
+    return Dirty ? 0 : NextTrigger;
+  }
+
+  // "sun" .. "sat" to timeDayOfWeek_t, -1 for anything else
+  static int parseDay(const char *name)
+  {
+    static const char *const names[] = {"sun", "mon", "tue", "wed", "thu", "fri", "sat"};
+
+    for (int i = 0; i < 7; i++)
+    {
+      if (strcmp(name, names[i]) == 0)
+      {
+        return dowSunday + i;
+      }
+    }
+    return -1;
   }
 
   ScheduleClass &get(timeDayOfWeek_t day)
@@ -204,18 +373,28 @@ public:
     }
   }
 
-  String toJSON() override
+  size_t toJSON(Print &out) override
   {
-    return "{\r\n" +
-           ((Mon.isEnabled()) ? " \"mon\": " + (String)Mon.toJSON() + ",\r\n" : "") + "" +
-           ((Tue.isEnabled()) ? " \"tue\": " + (String)Tue.toJSON() + ",\r\n" : "") + "" +
-           ((Wed.isEnabled()) ? " \"wed\": " + (String)Wed.toJSON() + ",\r\n" : "") + "" +
-           ((Thu.isEnabled()) ? " \"thu\": " + (String)Thu.toJSON() + ",\r\n" : "") + "" +
-           ((Fri.isEnabled()) ? " \"fri\": " + (String)Fri.toJSON() + ",\r\n" : "") + "" +
-           ((Sat.isEnabled()) ? " \"sat\": " + (String)Sat.toJSON() + ",\r\n" : "") + "" +
-           ((Sun.isEnabled()) ? " \"sun\": " + (String)Sun.toJSON() + ",\r\n" : "") + "" +
-           " \"AlarmID\": " + (String)AlarmID + ", \"enabled\": " + (String)isEnabled() + ", \"d\": " + (String)Duration + ", \"t\": \"" + (String)hour(Time) + ":" + (String)minute(Time) + "\"" +
-           "\r\n}";
+    static const char *const names[] = {"mon", "tue", "wed", "thu", "fri", "sat", "sun"};
+    static const timeDayOfWeek_t days[] = {dowMonday, dowTuesday, dowWednesday, dowThursday, dowFriday, dowSaturday, dowSunday};
+
+    size_t n = out.print("{\r\n");
+    for (int i = 0; i < 7; i++)
+    {
+      ScheduleClass &skd = get(days[i]);
+      if (skd.isEnabled())
+      {
+        n += out.print(" \"");
+        n += out.print(names[i]);
+        n += out.print("\": ");
+        n += skd.toJSON(out);
+        n += out.print(",\r\n");
+      }
+    }
+    n += out.print(' ');
+    n += fieldsToJSON(out);
+    n += out.print("\r\n}");
+    return n;
   }
 };
 
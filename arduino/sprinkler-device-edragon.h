@@ -7,6 +7,7 @@
 #define RELAY_PIN2 13
 
 #include "sprinkler-device.h"
+#include "includes/ButtonEvents.h"
 
 extern SprinklerDevice Device = SprinklerDevice([]()
 {
@@ -16,18 +17,13 @@ extern SprinklerDevice Device = SprinklerDevice([]()
 
     pinMode(RELAY_PIN, OUTPUT);
 
-    attachInterrupt(digitalPinToInterrupt(BTN_PIN), []() 
-    {
-        if (Sprinkler.isWatering())
-        {
-            Sprinkler.stop();
-        }
-        else
-        {
-            Sprinkler.start();
-        }
-    }, FALLING);
+    pinMode(RELAY_PIN2, OUTPUT);
+
+    Button.onShortPress(StaticDelegate::bind<SprinklerClass, &SprinklerClass::toggle>(&Sprinkler));
+    Button.onLongPress(StaticDelegate::bind<SprinklerClass, &SprinklerClass::togglePause>(&Sprinkler));
+    Button.onDoublePress(StaticDelegate::bind<SprinklerClass, &SprinklerClass::startNextZone>(&Sprinkler));
+    Button.setup(BTN_PIN);
     
-}, LED_PIN, RELAY_PIN);
+}, LED_PIN, {RELAY_PIN, RELAY_PIN2});
 
 #endif
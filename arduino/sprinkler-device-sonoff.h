@@ -6,14 +6,7 @@
 #define RELAY_PIN 12
 
 #include "sprinkler-device.h"
-
-void ICACHE_RAM_ATTR handleButtonInterrupt() {
-  if (Sprinkler.isWatering()) {
-    Sprinkler.stop();
-  } else {
-    Sprinkler.start();
-  }
-}
+#include "includes/ButtonEvents.h"
 
 extern SprinklerDevice Device = SprinklerDevice([]() {
   pinMode(LED_PIN, OUTPUT);
@@ -22,7 +15,10 @@ extern SprinklerDevice Device = SprinklerDevice([]() {
 
   pinMode(BTN_PIN, INPUT);
 
-  attachInterrupt(digitalPinToInterrupt(BTN_PIN), handleButtonInterrupt, FALLING);
+  Button.onShortPress(StaticDelegate::bind<SprinklerClass, &SprinklerClass::toggle>(&Sprinkler));
+  Button.onLongPress(StaticDelegate::bind<SprinklerClass, &SprinklerClass::togglePause>(&Sprinkler));
+  Button.onDoublePress(StaticDelegate::bind<SprinklerClass, &SprinklerClass::startNextZone>(&Sprinkler));
+  Button.setup(BTN_PIN);
 }, LED_PIN, RELAY_PIN);
 
 #endif
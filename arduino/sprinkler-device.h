@@ -3,12 +3,34 @@
 
 #include <EEPROM.h>
 #include <ESP8266WiFi.h>
+#include <Updater.h>
+#include <flash_hal.h>
+#include <initializer_list>
 
 #include "schedule.h"
 #include "sprinkler.h"
+#include "sprinkler-zones.h"
 #include "includes/Files.h"
+#include "includes/ConfigJournal.h"
 
 #define EEPROM_SIZE 1024
+#define DEVICE_JSON_SIZE 256
+#define CONFIG_JOURNAL_SECTORS 4
+
+// quiet period before a changed config is written to flash
+#ifndef CONFIG_SAVE_DELAY
+#define CONFIG_SAVE_DELAY 5000
+#endif
+
+// config journal keys
+enum {
+  configFullName,
+  configHostName,
+  configDispName,
+  configRevision,
+  configScheduler = 0x10,  // + 0 everyday, + dowSunday..dowSaturday
+  configZone = 0x20        // + zone index
+};
 
 struct SchedulerConfig {
   bool enabled;
@@ -17,19 +39,25 @@ struct SchedulerConfig {
   unsigned int duration;
 };
 
+struct ZoneConfig {
+  char name[SPRINKLER_ZONE_NAME_SIZE];
+  unsigned long duration;
+};
+
 struct SprinklerConfig {
   uint8_t version;
   char full_name[50];
   char host_name[50];
   char disp_name[50];
   SchedulerConfig scheduler[8];
+  ZoneConfig zone[SPRINKLER_MAX_ZONES];
 };
 
 class SprinklerDevice {
  private:
   std::function<void()> onSetup;
   uint8_t led_pin;
-  uint8_t rel_pin;
+  SprinklerZones zone_table;
 
   String host_name;
   String disp_name;
@@ -38,9 +66,116 @@ class SprinklerDevice {
 
   uint8_t revision;
 
+  ConfigJournal journal;
+  bool journaled;
+  bool dirty;
+  unsigned long dirtyTime;
+  uint32_t changeCount;
+
+  void mount() {
+    // the sketch does not mount a file system, the journal takes the last
+    // sectors of the FS region
+    uint32_t start = FS_PHYS_ADDR / JOURNAL_SECTOR_SIZE;
+    uint32_t end = (FS_PHYS_ADDR + FS_PHYS_SIZE) / JOURNAL_SECTOR_SIZE;
+    journaled = end >= start + CONFIG_JOURNAL_SECTORS && journal.begin(end - CONFIG_JOURNAL_SECTORS, CONFIG_JOURNAL_SECTORS);
+    if (!journaled) {
+      Serial.println("[JOURNAL] no flash space, using EEPROM");
+    }
+  }
+
+  bool read(SprinklerConfig &config) {
+    memset(&config, 0, sizeof(config));
+    if (!journal.read(configFullName, config.full_name, sizeof(config.full_name)) || !full_name.equals(config.full_name)) {
+      return false;
+    }
+
+    journal.read(configHostName, config.host_name, sizeof(config.host_name));
+    journal.read(configDispName, config.disp_name, sizeof(config.disp_name));
+    journal.read(configRevision, &config.version, sizeof(config.version));
+    for (uint8_t i = 0; i < 8; i++) {
+      journal.read(configScheduler + i, &config.scheduler[i], sizeof(config.scheduler[i]));
+    }
+    for (uint8_t i = 0; i < SPRINKLER_MAX_ZONES; i++) {
+      if (!journal.read(configZone + i, &config.zone[i], sizeof(config.zone[i]))) {
+        config.zone[i].name[0] = (char)0xFF;
+        config.zone[i].duration = ~0UL;
+      }
+    }
+    return true;
+  }
+
+  // appends one field to the journal and folds the outcome into result,
+  // nothing more is written once a write failed
+  void write(JournalResult &result, uint8_t key, const void *data, uint8_t size) {
+    if (result == journalFailed) return;
+
+    JournalResult written = journal.write(key, data, size);
+    if (written != journalUnchanged) result = written;
+  }
+
+  // appends only the fields that differ from the journal
+  JournalResult write(const SprinklerConfig &config) {
+    JournalResult result = journalUnchanged;
+    write(result, configFullName, config.full_name, sizeof(config.full_name));
+    write(result, configHostName, config.host_name, sizeof(config.host_name));
+    write(result, configDispName, config.disp_name, sizeof(config.disp_name));
+    for (uint8_t i = 0; i < 8; i++) {
+      write(result, configScheduler + i, &config.scheduler[i], sizeof(config.scheduler[i]));
+    }
+    for (uint8_t i = 0; i < zone_table.count(); i++) {
+      write(result, configZone + i, &config.zone[i], sizeof(config.zone[i]));
+    }
+    return result;
+  }
+
+  void apply(SprinklerConfig &config) {
+    Serial.print("[EEPROM] Display Name: ");
+    dispname(config.disp_name);
+    Serial.println(disp_name);
+    Serial.print("[EEPROM] Host Name: ");
+    hostname(config.host_name);
+    Serial.println(host_name);
+    revision = config.version;
+
+    Schedule.setDuration(config.scheduler[0].duration);
+    Schedule.setHour(config.scheduler[0].hour);
+    Schedule.setMinute(config.scheduler[0].minute);
+    if (config.scheduler[0].enabled) Schedule.enable();
+
+    for (int day = (int)dowSunday; day <= (int)dowSaturday; day++) {
+      ScheduleClass &skd = Schedule.get((timeDayOfWeek_t)day);
+      skd.setDuration(config.scheduler[day].duration);
+      skd.setHour(config.scheduler[day].hour);
+      skd.setMinute(config.scheduler[day].minute);
+
+      if (config.scheduler[day].enabled) skd.enable();
+    }
+
+    for (uint8_t i = 0; i < zone_table.count(); i++) {
+      ZoneConfig &zone = config.zone[i];
+      zone.name[sizeof(zone.name) - 1] = 0;
+      if ((uint8_t)zone.name[0] != 0xFF) zone_table.name(i, zone.name);
+      if (zone.duration <= SECS_PER_DAY * 1000UL) zone_table.duration(i, zone.duration);
+    }
+  }
+
+  static void store(SchedulerConfig &config, ScheduleClass &skd) {
+    config.enabled = skd.isEnabled();
+    config.hour = skd.getHour();
+    config.minute = skd.getMinute();
+    config.duration = skd.getDuration();
+  }
+
  public:
   SprinklerDevice(std::function<void(void)> onSetupCallback, uint8_t led, uint8_t rel)
-      : onSetup(onSetupCallback), led_pin(led), rel_pin(rel), revision(1) {
+      : SprinklerDevice(onSetupCallback, led, {rel}) {
+  }
+
+  SprinklerDevice(std::function<void(void)> onSetupCallback, uint8_t led, std::initializer_list<uint8_t> relays)
+      : onSetup(onSetupCallback), led_pin(led), revision(1), journaled(false), dirty(false), dirtyTime(0), changeCount(0) {
+    for (uint8_t pin : relays) {
+      zone_table.add(pin);
+    }
     disp_name = "Sprinkler";
     host_name = "sprinkler-" + String(ESP.getChipId(), HEX);
     full_name = "sprinkler-v" + (String)SKETCH_VERSION_MAJOR + "." + (String)SKETCH_VERSION_MINOR + "." + (String)SKETCH_VERSION_RELEASE + "_" + String(ESP.getChipId(), HEX);
@@ -93,6 +228,10 @@ class SprinklerDevice {
     return upds_addr;
   }
 
+  SprinklerZones &zones() {
+    return zone_table;
+  }
+
   void setup() {
     onSetup();
   }
@@ -100,93 +239,147 @@ class SprinklerDevice {
   void load() {
     Serial.println("[EEPROM] reading...");
     EEPROM.begin(EEPROM_SIZE);
+    mount();
+
     SprinklerConfig config;
-    EEPROM.get(0, config);
-    if (full_name.equals(config.full_name)) {
-      Serial.print("[EEPROM] Display Name: ");
-      dispname(config.disp_name);
-      Serial.println(disp_name);
-      Serial.print("[EEPROM] Host Name: ");
-      hostname(config.host_name);
-      Serial.println(host_name);
-      revision = config.version;
-
-      Schedule.setDuration(config.scheduler[0].duration);
-      Schedule.setHour(config.scheduler[0].hour);
-      Schedule.setMinute(config.scheduler[0].minute);
-      if (config.scheduler[0].enabled) Schedule.enable();
-
-      for (int day = (int)dowSunday; day <= (int)dowSaturday; day++) {
-        ScheduleClass &skd = Schedule.get((timeDayOfWeek_t)day);
-        skd.setDuration(config.scheduler[day].duration);
-        skd.setHour(config.scheduler[day].hour);
-        skd.setMinute(config.scheduler[day].minute);
-
-        if (config.scheduler[day].enabled) skd.enable();
+    if (journaled && !journal.empty()) {
+      if (read(config)) {
+        apply(config);
+        return;
       }
     } else {
-      Serial.println("[EEPROM] not found.");
+      EEPROM.get(0, config);
+      if (full_name.equals(config.full_name)) {
+        apply(config);
+        if (journaled) {
+          Serial.println("[JOURNAL] migrating EEPROM config");
+          commit();
+        }
+        return;
+      }
     }
+
+    Serial.println("[EEPROM] not found.");
   }
 
+  // write-behind, the config is committed once it was quiet for
+  // CONFIG_SAVE_DELAY, so a burst of edits costs a single flash write
   void save() {
-    Serial.println("[EEPROM] saving");
-    SprinklerConfig config = {
-        /*version*/   ++revision,
-        /*full_name*/ {0},
-        /*host_name*/ {0},
-        /*disp_name*/ {0},
-        /*scheduler*/ {
-           /*everyday*/ {Schedule.isEnabled(),     Schedule.getHour(), Schedule.getMinute(),     Schedule.getDuration()},
-            /*sun*/ {Schedule.Sun.isEnabled(), Schedule.Sun.getHour(), Schedule.Sun.getMinute(), Schedule.Sun.getDuration()},
-            /*mon*/ {Schedule.Mon.isEnabled(), Schedule.Mon.getHour(), Schedule.Mon.getMinute(), Schedule.Mon.getDuration()},
-            /*tue*/ {Schedule.Tue.isEnabled(), Schedule.Tue.getHour(), Schedule.Tue.getMinute(), Schedule.Tue.getDuration()},
-            /*wed*/ {Schedule.Wed.isEnabled(), Schedule.Wed.getHour(), Schedule.Wed.getMinute(), Schedule.Wed.getDuration()},
-            /*thu*/ {Schedule.Thu.isEnabled(), Schedule.Thu.getHour(), Schedule.Thu.getMinute(), Schedule.Thu.getDuration()},
-            /*fri*/ {Schedule.Fri.isEnabled(), Schedule.Fri.getHour(), Schedule.Fri.getMinute(), Schedule.Fri.getDuration()},
-            /*sat*/ {Schedule.Sat.isEnabled(), Schedule.Sat.getHour(), Schedule.Sat.getMinute(), Schedule.Sat.getDuration()}
+    changeCount++;
+    dirty = true;
+    dirtyTime = millis();
+  }
+
+  // number of config changes since boot, bumped by every save()
+  uint32_t changes() const {
+    return changeCount;
+  }
+
+  // commits a pending save right away, call it before restart or update
+  void flush() {
+    if (dirty) commit();
+  }
+
+  void handle() {
+    if (dirty && (millis() - dirtyTime >= CONFIG_SAVE_DELAY || Update.isRunning())) {
+      commit();
+    }
+  }
+
+  // writes the config, a failed write keeps it dirty and is retried after
+  // another quiet period
+  void commit() {
+    SprinklerConfig config;
+    memset(&config, 0, sizeof(config));  // padding is compared by the journal
+    config.version = revision;
+    strncpy(config.full_name, full_name.c_str(), sizeof(config.full_name) - 1);
+    strncpy(config.host_name, host_name.c_str(), sizeof(config.host_name) - 1);
+    strncpy(config.disp_name, disp_name.c_str(), sizeof(config.disp_name) - 1);
+    store(config.scheduler[0], Schedule);
+    for (int day = (int)dowSunday; day <= (int)dowSaturday; day++) {
+      store(config.scheduler[day], Schedule.get((timeDayOfWeek_t)day));
+    }
+    for (uint8_t i = 0; i < zone_table.count(); i++) {
+      strcpy(config.zone[i].name, zone_table[i].name);
+      config.zone[i].duration = zone_table[i].duration;
+    }
+
+    bool saved;
+    if (journaled) {
+      JournalResult result = write(config);
+      if (result == journalWritten) {
+        Serial.println("[JOURNAL] saved");
+        revision++;
       }
-    };
-    strcpy(config.full_name, full_name.c_str());
-    strcpy(config.host_name, host_name.c_str());
-    strcpy(config.disp_name, disp_name.c_str());
-    EEPROM.put(0, config);
-    EEPROM.commit();
+      // a revision that failed to write goes out with the retry, even when
+      // the fields are unchanged by then
+      config.version = revision;
+      write(result, configRevision, &config.version, sizeof(config.version));
+      saved = result != journalFailed;
+    } else {
+      Serial.println("[EEPROM] saving");
+      config.version = ++revision;
+      EEPROM.put(0, config);
+      saved = EEPROM.commit();
+    }
+
+    dirty = !saved;
+    if (dirty) {
+      Serial.println("[EEPROM] save failed, retrying later");
+      dirtyTime = millis();
+    }
   }
 
-  void turnOn() {
-    digitalWrite(led_pin, LOW);
-    digitalWrite(rel_pin, HIGH);
+  void turnOn(uint8_t zone) {
+    if (zone_table.exists(zone)) {
+      digitalWrite(led_pin, LOW);
+      digitalWrite(zone_table[zone].pin, HIGH);
+    }
+  }
+
+  void turnOff(uint8_t zone) {
+    if (zone_table.exists(zone)) {
+      digitalWrite(led_pin, HIGH);
+      digitalWrite(zone_table[zone].pin, LOW);
+    }
   }
 
   void turnOff() {
     digitalWrite(led_pin, HIGH);
-    digitalWrite(rel_pin, LOW);
+    for (uint8_t i = 0; i < zone_table.count(); i++) {
+      digitalWrite(zone_table[i].pin, LOW);
+    }
   }
 
   virtual void reset() {
     Serial.println("[MAIN] Factory reset requested.");
+    dirty = false;
     Serial.println("[EEPROM] clear");
     for (int i = 0; i < EEPROM.length(); i++) {
       EEPROM.write(i, 0);
     }
     EEPROM.commit();
+    if (journaled) journal.clear();
 
     WiFi.disconnect(true);
     ESP.restart();
   }
 
   virtual void restart() {
+    flush();
     Serial.println("[MAIN] Restarting...");
     ESP.restart();
   }
 
-  String toJSON() {
-    return (String) "{" +
-           "\r\n  \"disp_name\": \"" + disp_name + "\"" +
-           "\r\n ,\"host_name\": \"" + host_name + "\"" +
-           "\r\n ,\"upds_addr\": \"" + upds_addr + "\"" +
-           "\r\n}";
+  size_t toJSON(Print &out) {
+    size_t n = out.print("{\r\n  \"disp_name\": \"");
+    n += out.print(disp_name);
+    n += out.print("\"\r\n ,\"host_name\": \"");
+    n += out.print(host_name);
+    n += out.print("\"\r\n ,\"upds_addr\": \"");
+    n += out.print(upds_addr);
+    n += out.print("\"\r\n}");
+    return n;
   }
 };
 
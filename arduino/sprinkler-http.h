@@ -6,36 +6,147 @@
 #include <AsyncJson.h> 
 #include <Time.h>
 #include <TimeLib.h>
-#include <TimeAlarms.h>
 #include "Sprinkler.h"
+#include "sprinkler-wss.h"
 
 #include "includes/AsyncHTTPUpdateHandler.h"
 #include "includes/AsyncHTTPUpgradeHandler.h"
+#include "includes/AsyncAdmissionServer.h"
+#include "includes/AsyncAssetHandler.h"
+#include "includes/AsyncInjectedResponse.h"
+#include "includes/AsyncRouteHandler.h"
 #include "includes/Files.h"
 
+#define SNAPSHOT_MAX_WAITING ADMISSION_MAX_HELD  // long-poll requests held at once
+#define SNAPSHOT_MAX_WAIT 60     // seconds
+#define SNAPSHOT_JSON_SIZE (SPRINKLER_STATE_JSON_SIZE + SCHEDULE_WEEK_JSON_SIZE + DEVICE_JSON_SIZE + 64)
+#define INDEX_SNAPSHOT_SIZE (SPRINKLER_STATE_JSON_SIZE + SCHEDULE_WEEK_JSON_SIZE + 64)
+
+struct SnapshotWaiter
+{
+  AsyncWebServerRequest *request;
+  uint32_t version;
+  unsigned long deadline;
+};
+
 class SprinklerHttp
 {
 private:
+
+  SnapshotWaiter waiters[SNAPSHOT_MAX_WAITING];
+  AsyncAdmissionServer *server;
+  SprinklerWss *wss;
+
+  // changes whenever the state, the schedule or the settings do
+  static uint32_t snapshotVersion()
+  {
+    return Sprinkler.getVersion() + Device.changes();
+  }
+
+  static void snapshotETag(char (&etag)[16], uint32_t version)
+  {
+    snprintf(etag, sizeof(etag), "\"%u\"", version);
+  }
+
+  void respondSnapshot(AsyncWebServerRequest *request)
+  {
+    uint32_t version = snapshotVersion();
+    char etag[16];
+    snapshotETag(etag, version);
+
+    AsyncResponseStream *response = request->beginResponseStream("application/json", SNAPSHOT_JSON_SIZE);
+    response->addHeader("ETag", etag);
+    response->addHeader("Cache-Control", "no-cache");
+    response->print("{\r\n\"version\": ");
+    response->print(version);
+    response->print(",\r\n\"state\": ");
+    Sprinkler.toJSON(*response);
+    response->print(",\r\n\"schedule\": ");
+    Schedule.toJSON(*response);
+    response->print(",\r\n\"settings\": ");
+    Device.toJSON(*response);
+    response->print("\r\n}");
+    request->send(response);
+  }
+
+  void respondNotModified(AsyncWebServerRequest *request, uint32_t version)
+  {
+    char etag[16];
+    snapshotETag(etag, version);
+
+    AsyncWebServerResponse *response = request->beginResponse(304);
+    response->addHeader("ETag", etag);
+    request->send(response);
+  }
+
+  // state, schedule and settings in one response. With If-None-Match set to
+  // the current version it answers 304, with ?wait=<seconds> it holds the
+  // request until the version moves on or the time is up.
+  void respondSnapshotRequest(AsyncWebServerRequest *request)
+  {
+    uint32_t version = snapshotVersion();
+    char etag[16];
+    snapshotETag(etag, version);
+
+    if (!request->header("If-None-Match").equals(etag))
+      return respondSnapshot(request);
+
+    long wait = request->hasArg("wait") ? request->arg("wait").toInt() : 0;
+    if (wait <= 0)
+      return respondNotModified(request, version);
+    if (wait > SNAPSHOT_MAX_WAIT)
+      wait = SNAPSHOT_MAX_WAIT;
+
+    for (SnapshotWaiter &waiter : waiters)
+    {
+      if (!waiter.request && server->hold(request))
+      {
+        waiter.request = request;
+        waiter.version = version;
+        waiter.deadline = millis() + wait * 1000UL;
+
+        request->onDisconnect([&waiter, request]() {
+          if (waiter.request == request)
+            waiter.request = nullptr;
+        });
+        return;
+      }
+    }
+
+    // all slots taken, let the client poll again
+    respondNotModified(request, version);
+  }
   
-  char lastModified[50];
-  void respondCachedRequest(AsyncWebServerRequest *request, const String& contentType, const uint8_t * content, size_t len){
-    if (request->header("If-Modified-Since").equals(lastModified)) {
-      
-      request->send(304);
-  
-    } else {
-  
-        // Dump the byte array in PROGMEM with a 200 HTTP code (OK)
-        AsyncWebServerResponse *response = request->beginResponse_P(200, contentType, content, len);
-  
-        // Tell the browswer the contemnt is Gzipped
-        response->addHeader("Content-Encoding", "gzip");
-  
-        // And set the last-modified datetime so we can check if we need to send it again next time or not
-        response->addHeader("Last-Modified", lastModified);
-  
-        request->send(response);
+  // the page with the state and schedule rendered in, the first paint needs
+  // no api round trips. The ETag changes with the page and the snapshot.
+  void respondIndexRequest(AsyncWebServerRequest *request)
+  {
+    uint32_t version = snapshotVersion();
+    char etag[40];
+    snprintf(etag, sizeof(etag), "\"%s-%u\"", SKETCH_INDEX_HTML_INJECT.hash, version);
+
+    AsyncWebServerResponse *response;
+    if (request->header("If-None-Match").equals(etag))
+    {
+      response = request->beginResponse(304);
+    }
+    else
+    {
+      AsyncInjectedResponse<INDEX_SNAPSHOT_SIZE> *page = new AsyncInjectedResponse<INDEX_SNAPSHOT_SIZE>("text/html", SKETCH_INDEX_HTML_INJECT);
+      Print &out = page->content();
+      out.print("{\"version\":");
+      out.print(version);
+      out.print(",\"state\":");
+      Sprinkler.toJSON(out);
+      out.print(",\"schedule\":");
+      Schedule.toJSON(out);
+      out.print("}");
+      response = page;
     }
+
+    response->addHeader("ETag", etag);
+    response->addHeader("Cache-Control", "no-cache");
+    request->send(response);
   }
 
   void respondManifestRequest(AsyncWebServerRequest *request)
@@ -55,19 +166,28 @@ private:
                                          "}");
   }
 
+  template <typename T>
+  void respondJSON(AsyncWebServerRequest *request, T &source, size_t size)
+  {
+    // stream straight into the response buffer, no intermediate String
+    AsyncResponseStream *response = request->beginResponseStream("application/json", size);
+    source.toJSON(*response);
+    request->send(response);
+  }
+
   void respondStateRequest(AsyncWebServerRequest *request)
   {
-    request->send(200, "application/json", Sprinkler.toJSON());
+    respondJSON(request, Sprinkler, SPRINKLER_STATE_JSON_SIZE);
   }
 
   void respondScheduleStateRequest(AsyncWebServerRequest *request)
   {
-    request->send(200, "application/json", Schedule.toJSON());
+    respondJSON(request, Schedule, SCHEDULE_WEEK_JSON_SIZE);
   }
 
   void respondScheduleStateRequest(timeDayOfWeek_t day, AsyncWebServerRequest *request)
   {
-    request->send(200, "application/json", Schedule.get(day).toJSON());
+    respondJSON(request, Schedule.get(day), SCHEDULE_JSON_SIZE);
   }
 
   void respondResetRequest(AsyncWebServerRequest *request)
@@ -152,9 +272,115 @@ private:
     respondScheduleStateRequest(day, request);
   }
 
+  void respondScheduleRequest(AsyncWebServerRequest *request, const char *day)
+  {
+    int dow = ScheduleWeek::parseDay(day);
+    if (dow == -1)
+      return respond404Request(request);
+
+    respondScheduleRequest((timeDayOfWeek_t)dow, request);
+  }
+
+  // { "enabled": 1, "d": 15, "t": "6:30" } - every field is optional
+  static bool parseProgram(JsonVariant json, ScheduleProgram &program)
+  {
+    if (!json.is<JsonObject>())
+      return false;
+
+    program.hours = -1;
+    program.minutes = -1;
+    program.duration = -1;
+    program.enable = -1;
+
+    if (json.containsKey("d"))
+    {
+      if (!json["d"].is<int>())
+        return false;
+      program.duration = json["d"].as<int>();
+    }
+
+    if (json.containsKey("enabled"))
+    {
+      if (!json["enabled"].is<int>())
+        return false;
+      program.enable = json["enabled"].as<int>();
+    }
+
+    const char *time = json["t"];
+    if (time && sscanf(time, "%d:%d", &program.hours, &program.minutes) != 2)
+      return false;
+
+    return true;
+  }
+
+  // the whole week in one document, shaped like the GET /api/schedule response:
+  // { "enabled": 0, "d": 15, "t": "6:30", "mon": { "enabled": 1, "d": 10, "t": "7:00" }, ... }
+  void respondScheduleBatchRequest(AsyncWebServerRequest *request, JsonVariant &json)
+  {
+    // programs are kept as times of day, they cannot be placed before the clock is set
+    if (timeStatus() == timeNotSet)
+      return request->send(503, "text/plain", "Time not set.");
+
+    ScheduleProgram week[8];
+    for (ScheduleProgram &program : week)
+    {
+      program = {-1, -1, -1, -1};
+    }
+
+    bool valid = parseProgram(json, week[0]);
+    for (JsonPair pair : json.as<JsonObject>())
+    {
+      int dow = ScheduleWeek::parseDay(pair.key().c_str());
+      if (dow != -1)
+      {
+        valid = valid && parseProgram(pair.value(), week[dow]);
+      }
+    }
+
+    if (!valid || !Sprinkler.schedule(week))
+      return request->send(400, "text/plain", "Invalid schedule.");
+
+    respondScheduleStateRequest(request);
+  }
+
+  void respondZonesStateRequest(AsyncWebServerRequest *request)
+  {
+    AsyncResponseStream *response = request->beginResponseStream("application/json", SPRINKLER_ZONES_JSON_SIZE);
+    Sprinkler.zonesToJSON(*response);
+    request->send(response);
+  }
+
+  void respondZoneRequest(AsyncWebServerRequest *request)
+  {
+    if (request->hasArg("z"))
+    {
+      Sprinkler.setZone(
+          request->arg("z").toInt(),
+          request->hasArg("name") ? request->arg("name").c_str() : nullptr,
+          request->hasArg("d") ? request->arg("d").toInt() : -1);
+    }
+
+    respondZonesStateRequest(request);
+  }
+
   void respondSettingsRequest(AsyncWebServerRequest *request)
   {
-    request->send(200, "application/json", Device.toJSON());
+    respondJSON(request, Device, DEVICE_JSON_SIZE);
+  }
+
+  void respondStatsRequest(AsyncWebServerRequest *request)
+  {
+    const AdmissionStats &stats = server->getStats();
+
+    AsyncResponseStream *response = request->beginResponseStream("application/json", 128);
+    response->printf("{\"accepted\": %u, \"rejected\": %u, \"shed\": %u, \"active\": %u, \"held\": %u, \"heap\": %u}",
+                     stats.accepted, stats.rejected, stats.shed, stats.active, stats.held, ESP.getFreeHeap());
+    request->send(response);
+  }
+
+  void respondClientsRequest(AsyncWebServerRequest *request)
+  {
+    respondJSON(request, *wss, WSS_STATS_JSON_SIZE);
   }
 
   void respond404Request(AsyncWebServerRequest *request)
@@ -207,38 +433,65 @@ private:
 
 public:
 
-  SprinklerHttp()
+  SprinklerHttp() : waiters(), server(nullptr), wss(nullptr)
   {
-    sprintf(lastModified, "%s %s GMT", __DATE__, __TIME__);
   }
 
-  void setup(AsyncWebServer &server)
+  // releases long-poll snapshot requests, call it from loop()
+  void handle()
   {
-   
-    server.on("/", HTTP_GET, [&](AsyncWebServerRequest *request){
-      respondCachedRequest(request, "text/html", SKETCH_INDEX_HTML_GZ, sizeof(SKETCH_INDEX_HTML_GZ));
-    });
-    server.on("/favicon.png", HTTP_GET, [&](AsyncWebServerRequest *request){
-      respondCachedRequest(request, "image/png", SKETCH_FAVICON_PNG_GZ, sizeof(SKETCH_FAVICON_PNG_GZ));
-    });
-    server.on("/apple-touch-icon.png", HTTP_GET, [&](AsyncWebServerRequest *request){
-      respondCachedRequest(request, "image/png", SKETCH_APPLE_TOUCH_ICON_PNG_GZ, sizeof(SKETCH_APPLE_TOUCH_ICON_PNG_GZ));
-    });
-
-    server.on("/manifest.json", HTTP_GET, [&](AsyncWebServerRequest *request){
-      respondManifestRequest(request);
-    });
+    uint32_t version = snapshotVersion();
+    for (SnapshotWaiter &waiter : waiters)
+    {
+      if (!waiter.request)
+        continue;
 
-    server.on("/reset", HTTP_GET, [&](AsyncWebServerRequest *request) {
-      respondResetRequest(request);
-    });
-    server.on("/restart", HTTP_GET, [&](AsyncWebServerRequest *request) {
-      respondRestartRequest(request);
-    });
+      AsyncWebServerRequest *request = waiter.request;
+      if (waiter.version != version)
+      {
+        waiter.request = nullptr;
+        respondSnapshot(request);
+      }
+      else if ((long)(millis() - waiter.deadline) >= 0)
+      {
+        waiter.request = nullptr;
+        respondNotModified(request, version);
+      }
+    }
+  }
 
-    server.on("/api/settings", HTTP_GET, [&](AsyncWebServerRequest *request) {
-      respondSettingsRequest(request);
-    });
+  void setup(AsyncAdmissionServer &server, SprinklerWss &wss)
+  {
+    this->server = &server;
+    this->wss = &wss;
+
+    typedef AsyncRouteHandler<SprinklerHttp> Router;
+
+    // keep sorted by path
+    static const Router::Route routes[] = {
+      {HTTP_GET, "/",                     &SprinklerHttp::respondIndexRequest,          nullptr},
+      {HTTP_GET, "/api/clients",          &SprinklerHttp::respondClientsRequest,        nullptr},
+      {HTTP_GET, "/api/off",              &SprinklerHttp::respondStopRequest,           nullptr},
+      {HTTP_GET, "/api/on",               &SprinklerHttp::respondStartRequest,          nullptr},
+      {HTTP_GET, "/api/pause",            &SprinklerHttp::respondPauseRequest,          nullptr},
+      {HTTP_GET, "/api/resume",           &SprinklerHttp::respondResumeRequest,         nullptr},
+      {HTTP_GET, "/api/schedule",         &SprinklerHttp::respondScheduleRequest,       nullptr},
+      {HTTP_GET, "/api/schedule/",        nullptr,                                      &SprinklerHttp::respondScheduleRequest},
+      {HTTP_GET, "/api/settings",         &SprinklerHttp::respondSettingsRequest,       nullptr},
+      {HTTP_GET, "/api/snapshot",         &SprinklerHttp::respondSnapshotRequest,       nullptr},
+      {HTTP_GET, "/api/start",            &SprinklerHttp::respondStartRequest,          nullptr},
+      {HTTP_GET, "/api/state",            &SprinklerHttp::respondStateRequest,          nullptr},
+      {HTTP_GET, "/api/stats",            &SprinklerHttp::respondStatsRequest,          nullptr},
+      {HTTP_GET, "/api/stop",             &SprinklerHttp::respondStopRequest,           nullptr},
+      {HTTP_GET, "/api/zone",             &SprinklerHttp::respondZoneRequest,           nullptr},
+      {HTTP_GET, "/api/zones",            &SprinklerHttp::respondZonesStateRequest,     nullptr},
+      {HTTP_GET, "/index.html",           &SprinklerHttp::respondIndexRequest,          nullptr},
+      {HTTP_GET, "/manifest.json",        &SprinklerHttp::respondManifestRequest,       nullptr},
+      {HTTP_GET, "/reset",                &SprinklerHttp::respondResetRequest,          nullptr},
+      {HTTP_GET, "/restart",              &SprinklerHttp::respondRestartRequest,        nullptr},
+    };
+
+    server.addHandler(new Router(this, routes));
 
     server.addHandler(new AsyncCallbackJsonWebHandler("/api/settings", [&](AsyncWebServerRequest *request, JsonVariant &jsonDoc) {      
       if (jsonDoc)
@@ -269,57 +522,16 @@ public:
       }
     }));
 
-    server.on("/api/on", HTTP_GET, [&](AsyncWebServerRequest *request){
-      respondStartRequest(request);
-    });
-    server.on("/api/off", HTTP_GET, [&](AsyncWebServerRequest *request){
-      respondStopRequest(request);
-    });
-    server.on("/api/state", HTTP_GET, [&](AsyncWebServerRequest *request){
-      respondStateRequest(request);
-    });
-    server.on("/api/start", HTTP_GET, [&](AsyncWebServerRequest *request){
-      respondStartRequest(request);
-    });
-    server.on("/api/stop", HTTP_GET, [&](AsyncWebServerRequest *request){
-      respondStopRequest(request);
-    });
-    server.on("/api/pause", HTTP_GET, [&](AsyncWebServerRequest *request){
-      respondPauseRequest(request);
-    });
-    server.on("/api/resume", HTTP_GET, [&](AsyncWebServerRequest *request){
-      respondResumeRequest(request);
-    });
-
-    server.on("/api/schedule/mon", HTTP_GET, [&](AsyncWebServerRequest *request){
-      respondScheduleRequest(dowMonday, request);
-    });
-    server.on("/api/schedule/tue", HTTP_GET, [&](AsyncWebServerRequest *request){
-      respondScheduleRequest(dowTuesday, request);
-    });
-    server.on("/api/schedule/wed", HTTP_GET, [&](AsyncWebServerRequest *request){
-      respondScheduleRequest(dowWednesday, request);
-    });
-    server.on("/api/schedule/thu", HTTP_GET, [&](AsyncWebServerRequest *request){
-      respondScheduleRequest(dowThursday, request);
-    });
-    server.on("/api/schedule/fri", HTTP_GET, [&](AsyncWebServerRequest *request){
-      respondScheduleRequest(dowFriday, request);
-    });
-    server.on("/api/schedule/sat", HTTP_GET, [&](AsyncWebServerRequest *request){
-      respondScheduleRequest(dowSaturday, request);
-    });
-    server.on("/api/schedule/sun", HTTP_GET, [&](AsyncWebServerRequest *request){
-      respondScheduleRequest(dowSunday, request);
-    });
-    server.on("/api/schedule", HTTP_GET, [&](AsyncWebServerRequest *request){
-      respondScheduleRequest(request);
-    });
+    server.addHandler(new AsyncCallbackJsonWebHandler("/api/schedule", [&](AsyncWebServerRequest *request, JsonVariant &json) {
+      respondScheduleBatchRequest(request, json);
+    }));
 
     server.addHandler(new AsyncHTTPUpdateHandler("/esp/update", HTTP_POST));
 
     server.addHandler(new AsyncHTTPUpgradeHandler("/esp/upgrade", HTTP_POST, "https://ota.voights.net/sprinkler.bin"));
 
+    server.addHandler(new AsyncAssetHandler());
+
     server.onNotFound([&](AsyncWebServerRequest *request){
       respond404Request(request);
     });
@@ -5,7 +5,6 @@
 #include <ESP8266WiFi.h>
 #include <Time.h>
 #include <TimeLib.h>
-#include <TimeAlarms.h>
 
 #define NTP_TIMEZONE -4
 #define NTP_SERVER1 "pool.ntp.org"
@@ -4,30 +4,461 @@
 #include <vector>
 #include <algorithm>
 #include <Hash.h>
+#include <Ticker.h>
+#include <ArduinoJson.h>
 #include "Sprinkler.h"
+#include "includes/PrintBuffer.h"
+
+#define WSS_COMMAND_JSON_SIZE 256  // { "id": 1, "cmd": "settings", "disp_name": "...", "upds_addr": "..." }
+#define WSS_REPLY_SIZE (SCHEDULE_WEEK_JSON_SIZE + 32)
+#ifndef WSS_MAX_CLIENTS
+#define WSS_MAX_CLIENTS DEFAULT_MAX_WS_CLIENTS  // dashboards connected at once, more are refused
+#endif
+#ifndef WSS_PING_INTERVAL
+#define WSS_PING_INTERVAL 10000  // ms between liveness sweeps, a pong missing by the next one closes the client
+#endif
+#define WSS_STATS_JSON_SIZE (WSS_MAX_CLIENTS * 160 + 96)
+
+struct SprinklerSubscriber
+{
+  uint32_t id;       // websocket client id, 0 - free slot
+  uint32_t version;  // last state version acknowledged by the client
+  bool msgpack;      // state frames as binary MessagePack instead of JSON text
+  bool pinging;      // a ping is waiting for its pong
+  unsigned long pingTime;
+  uint16_t rtt;      // ms, last pong
+  uint16_t rttAverage;
+};
+
+struct SprinklerWssStats
+{
+  uint32_t pings;
+  uint32_t timeouts;  // clients closed for a missing pong
+  uint32_t refused;   // over WSS_MAX_CLIENTS
+};
 
 class SprinklerWss
 {
 private:
 
-  static void handleEvent(AsyncWebSocket * server, AsyncWebSocketClient * client, AwsEventType type, void * arg, uint8_t *data, size_t len)
+  // prints the result into the reply, returns an error message instead when
+  // the arguments are not valid
+  typedef const char *(SprinklerWss::*Command)(JsonObject args, Print &result);
+
+  struct CommandEntry
+  {
+    const char *name;
+    Command command;
+  };
+
+  // a client refused on connect, aborted if it is still there a sweep later
+  struct RefusedClient
+  {
+    AsyncWebSocketClient *client;
+    unsigned long time;
+  };
+
+  AsyncWebSocket *wss;
+  SprinklerSubscriber subscribers[WSS_MAX_CLIENTS];
+  RefusedClient refused[WSS_MAX_CLIENTS];
+  SprinklerWssStats stats;
+  unsigned long lastSweep;
+  bool unsent;  // a push could not be allocated, broadcast() runs again from handle()
+  PrintBuffer<WSS_REPLY_SIZE> reply;  // events run one at a time, they share it
+  Ticker restart;
+
+  SprinklerSubscriber *subscriber(uint32_t id)
+  {
+    for (auto &s : subscribers)
+    {
+      if (s.id == id)
+        return &s;
+    }
+    return nullptr;
+  }
+
+  // drops the TCP connection of a refused client that did not answer the close
+  void abortRefused(RefusedClient &r)
+  {
+    AsyncWebSocketClient *client = r.client;
+    r.client = nullptr;
+    Serial.printf("[WSS] refused client %u did not close, aborting\n", client->id());
+    client->client()->close(true);
+  }
+
+  void refuse(AsyncWebSocketClient *client)
+  {
+    stats.refused++;
+    client->close(1013, "Too many clients");
+
+    RefusedClient *slot = &refused[0];
+    for (auto &r : refused)
+    {
+      if (!r.client)
+      {
+        slot = &r;
+        break;
+      }
+      if ((long)(r.time - slot->time) < 0)
+        slot = &r;
+    }
+
+    // more refused at once than slots, the oldest one has had its time
+    if (slot->client)
+      abortRefused(*slot);
+    *slot = {client, millis()};
+  }
+
+  static bool sameGroup(const SprinklerSubscriber &a, const SprinklerSubscriber &b)
+  {
+    return a.version == b.version && a.msgpack == b.msgpack;
+  }
+
+  // sends every subscriber only the fields it has not acknowledged yet. The
+  // state is serialized once per acknowledged version and encoding. A group
+  // of several subscribers shares one buffer, each client still queues a
+  // message of its own. A subscriber alone in its group gets a plain copy,
+  // the shared buffer would cost it more allocations than it saves.
+  void broadcast()
+  {
+    unsent = false;
+    uint32_t version = Sprinkler.getVersion();
+    bool pending[WSS_MAX_CLIENTS];
+    for (uint8_t i = 0; i < WSS_MAX_CLIENTS; i++)
+    {
+      SprinklerSubscriber &s = subscribers[i];
+      if (s.id && !wss->client(s.id))
+        s.id = 0;
+      pending[i] = s.id && s.version != version;
+    }
+
+    for (uint8_t i = 0; i < WSS_MAX_CLIENTS; i++)
+    {
+      if (!pending[i])
+        continue;
+
+      SprinklerSubscriber &group = subscribers[i];
+      uint8_t members = 0;
+      for (uint8_t j = i; j < WSS_MAX_CLIENTS; j++)
+      {
+        if (pending[j] && sameGroup(subscribers[j], group))
+          members++;
+      }
+
+      if (members == 1)
+      {
+        pending[i] = false;
+        unsent |= !send(wss->client(group.id), &group, group.version);
+        continue;
+      }
+
+      // out of memory, the group is tried again from handle()
+      AsyncWebSocketMessageBuffer *buffer = serialize(group.msgpack, group.version);
+      if (!buffer || !buffer->get())
+      {
+        unsent = true;
+        continue;
+      }
+
+      buffer->lock();
+      for (uint8_t j = i; j < WSS_MAX_CLIENTS; j++)
+      {
+        SprinklerSubscriber &s = subscribers[j];
+        if (!pending[j] || !sameGroup(s, group))
+          continue;
+
+        pending[j] = false;
+        queue(wss->client(s.id), &s, buffer);
+      }
+      buffer->unlock();
+    }
+
+    // frees the buffers no queue took
+    wss->_cleanBuffers();
+  }
+
+  AsyncWebSocketMessageBuffer *serialize(bool msgpack, uint32_t since)
+  {
+    if (msgpack)
+    {
+      PrintBuffer<SPRINKLER_STATE_MSGPACK_SIZE> state;
+      Sprinkler.toMsgPack(state, since);
+      return wss->makeBuffer((uint8_t *)state.c_str(), state.length());
+    }
+
+    PrintBuffer<SPRINKLER_STATE_JSON_SIZE> state;
+    Sprinkler.toJSON(state, since);
+    return wss->makeBuffer((uint8_t *)state.c_str(), state.length());
+  }
+
+  // serializes the state for one client into a message of its own, false if
+  // it could not be allocated
+  bool send(AsyncWebSocketClient *client, SprinklerSubscriber *s, uint32_t since)
+  {
+    if (s->msgpack)
+    {
+      PrintBuffer<SPRINKLER_STATE_MSGPACK_SIZE> state;
+      Sprinkler.toMsgPack(state, since);
+      return queue(client, new AsyncWebSocketBasicMessage(state.c_str(), state.length(), WS_BINARY));
+    }
+
+    PrintBuffer<SPRINKLER_STATE_JSON_SIZE> state;
+    Sprinkler.toJSON(state, since);
+    return queue(client, new AsyncWebSocketBasicMessage(state.c_str(), state.length()));
+  }
+
+  // the whole state, a client that could not be sent it gets it from handle()
+  void sendState(AsyncWebSocketClient *client, SprinklerSubscriber *s)
+  {
+    if (!send(client, s, 0))
+    {
+      s->version = 0;
+      unsent = true;
+    }
+  }
+
+  static bool queue(AsyncWebSocketClient *client, AsyncWebSocketMessage *message)
+  {
+    // a failed copy leaves the message in its error state
+    if (!message || message->finished())
+    {
+      delete message;
+      return false;
+    }
+
+    client->message(message, true);
+    return true;
+  }
+
+  // state frames are queued latest-value: each one holds every field changed
+  // since the acknowledged version, so it replaces a frame the client has
+  // not started to receive and a slow client never has more than one queued
+  static void queue(AsyncWebSocketClient *client, SprinklerSubscriber *s, AsyncWebSocketMessageBuffer *buffer)
+  {
+    if (s->msgpack)
+      client->binary(buffer, true);
+    else
+      client->text(buffer, true);
+  }
+
+  static int argument(JsonObject args, const char *name)
+  {
+    return args.containsKey(name) ? args[name].as<int>() : -1;
+  }
+
+  const char *stateCommand(JsonObject args, Print &result)
+  {
+    (void)args;
+    Sprinkler.toJSON(result);
+    return nullptr;
+  }
+
+  // { "t": minutes, "z": zones } - like GET /api/start
+  const char *startCommand(JsonObject args, Print &result)
+  {
+    if (args.containsKey("t"))
+    {
+      Sprinkler.setDuration(args["t"].as<int>() * 60 * 1000);
+    }
+
+    if (args.containsKey("z"))
+    {
+      Sprinkler.setTimes(args["z"].as<int>());
+
+      if (!Sprinkler.getDuration())
+      {
+        Sprinkler.setDuration(15 * 60 * 1000);
+      }
+    }
+    else
+    {
+      Sprinkler.setTimes(0);
+    }
+
+    Sprinkler.start();
+    return stateCommand(args, result);
+  }
+
+  const char *stopCommand(JsonObject args, Print &result)
+  {
+    Sprinkler.stop();
+    return stateCommand(args, result);
+  }
+
+  const char *pauseCommand(JsonObject args, Print &result)
+  {
+    Sprinkler.pause();
+    return stateCommand(args, result);
+  }
+
+  const char *resumeCommand(JsonObject args, Print &result)
+  {
+    Sprinkler.resume();
+    return stateCommand(args, result);
+  }
+
+  // { "day": "mon", "h": 6, "m": 30, "d": 15, "enabled": 1 } - every field is
+  // optional, without a day the default program is changed
+  const char *scheduleCommand(JsonObject args, Print &result)
+  {
+    const char *day = args["day"];
+    if (!day)
+    {
+      Sprinkler.schedule(argument(args, "h"), argument(args, "m"), argument(args, "d"), argument(args, "enabled"));
+      Schedule.toJSON(result);
+      return nullptr;
+    }
+
+    int dow = ScheduleWeek::parseDay(day);
+    if (dow == -1)
+      return "Invalid day.";
+
+    Sprinkler.schedule((timeDayOfWeek_t)dow, argument(args, "h"), argument(args, "m"), argument(args, "d"), argument(args, "enabled"));
+    Schedule.get((timeDayOfWeek_t)dow).toJSON(result);
+    return nullptr;
+  }
+
+  // { "disp_name": "...", "upds_addr": "..." } - a new name restarts the
+  // device, once the reply is out
+  const char *settingsCommand(JsonObject args, Print &result)
+  {
+    const char *dispname = args["disp_name"];
+    const char *updsaddr = args["upds_addr"];
+
+    if (dispname)
+      Device.dispname(dispname);
+    if (updsaddr)
+      Device.updsaddr(updsaddr);
+    if (dispname || updsaddr)
+      Device.save();
+
+    if (dispname)
+    {
+      restart.once_ms_scheduled(200, [] { Device.restart(); });
+    }
+
+    Device.toJSON(result);
+    return nullptr;
+  }
+
+  // { "enc": "msgpack" } or { "enc": "json" } picks the encoding of the state
+  // frames and resends the whole state in it, { "ack": version } acknowledges
+  // a state push, { "id": 1, "cmd": "start", ... }
+  // runs a command and is answered on the same socket with { "id": 1, "result": ... }
+  // or { "id": 1, "error": "..." }. Pushes never carry an id.
+  void handleMessage(AsyncWebSocketClient *client, uint8_t *data, size_t len)
+  {
+    static const CommandEntry commands[] = {
+      {"pause",     &SprinklerWss::pauseCommand},
+      {"resume",    &SprinklerWss::resumeCommand},
+      {"schedule",  &SprinklerWss::scheduleCommand},
+      {"settings",  &SprinklerWss::settingsCommand},
+      {"start",     &SprinklerWss::startCommand},
+      {"state",     &SprinklerWss::stateCommand},
+      {"stop",      &SprinklerWss::stopCommand},
+    };
+
+    StaticJsonDocument<WSS_COMMAND_JSON_SIZE> json;
+    if (deserializeJson(json, (const char *)data, len) != DeserializationError::Ok)
+      return;
+
+    SprinklerSubscriber *s = subscriber(client->id());
+
+    const char *encoding = json["enc"];
+    if (encoding)
+    {
+      if (s)
+      {
+        s->msgpack = strcmp(encoding, "msgpack") == 0;
+        sendState(client, s);
+      }
+      return;
+    }
+
+    if (json.containsKey("ack"))
+    {
+      uint32_t ack = json["ack"];
+      if (s && ack <= Sprinkler.getVersion())
+        s->version = ack;
+      return;
+    }
+
+    if (!json.containsKey("id"))
+      return;
+
+    uint32_t id = json["id"];
+    const char *name = json["cmd"] | "";
+    const char *error = "Unknown command.";
+
+    reply.clear();
+    reply.print("{\"id\":");
+    reply.print(id);
+    reply.print(",\"result\":");
+
+    for (const CommandEntry &entry : commands)
+    {
+      if (strcmp(entry.name, name) == 0)
+      {
+        error = (this->*entry.command)(json.as<JsonObject>(), reply);
+        break;
+      }
+    }
+
+    if (error)
+    {
+      reply.clear();
+      reply.print("{\"id\":");
+      reply.print(id);
+      reply.print(",\"error\":\"");
+      reply.print(error);
+      reply.print('"');
+    }
+    reply.print('}');
+
+    client->text(reply.c_str(), reply.length());
+  }
+
+  void handleEvent(AsyncWebSocket * server, AsyncWebSocketClient * client, AwsEventType type, void * arg, uint8_t *data, size_t len)
   {
 
     if(type == WS_EVT_CONNECT){
       //client connected
       os_printf("ws[%s][%u] connect\n", server->url(), client->id());
 
-      String state = Sprinkler.toJSON();
-      server->text(client->id(), state);
+      SprinklerSubscriber *s = subscriber(0);
+      if (!s)
+        return refuse(client);
+      *s = {client->id(), 0, false, false, 0, 0, 0};
+
+      sendState(client, s);
     } else if(type == WS_EVT_DISCONNECT){
       //client disconnected
       os_printf("ws[%s][%u] disconnect: %u\n", server->url(), client->id());
+
+      SprinklerSubscriber *s = subscriber(client->id());
+      if (s)
+        s->id = 0;
+
+      for (auto &r : refused)
+      {
+        if (r.client == client)
+          r.client = nullptr;
+      }
     } else if(type == WS_EVT_ERROR){
       //error was received from the other end
       os_printf("ws[%s][%u] error(%u): %s\n", server->url(), client->id(), *((uint16_t*)arg), (char*)data);
     } else if(type == WS_EVT_PONG){
       //pong message was received (in response to a ping request maybe)
       os_printf("ws[%s][%u] pong[%u]: %s\n", server->url(), client->id(), len, (len)?(char*)data:"");
+
+      SprinklerSubscriber *s = subscriber(client->id());
+      if (s && s->pinging)
+      {
+        s->pinging = false;
+        unsigned long rtt = millis() - s->pingTime;
+        s->rtt = rtt < UINT16_MAX ? rtt : UINT16_MAX;
+        s->rttAverage = s->rttAverage ? (s->rttAverage * 7 + s->rtt) / 8 : s->rtt;
+      }
     } else if(type == WS_EVT_DATA){
       //data packet
       AwsFrameInfo * info = (AwsFrameInfo*)arg;
@@ -37,6 +468,7 @@ private:
         if(info->opcode == WS_TEXT){
           data[len] = 0;
           os_printf("%s\n", (char*)data);
+          handleMessage(client, data, len);
         } else {
           for(size_t i=0; i < info->len; i++){
             os_printf("%02x ", data[i]);
@@ -74,14 +506,92 @@ private:
 
 public:
 
-  void setup(AsyncWebSocket &wss)
+  SprinklerWss() : wss(nullptr), subscribers(), refused(), stats(), lastSweep(0), unsent(false), reply()
   {
-    Sprinkler.onChange([&](){
-      String state = Sprinkler.toJSON();
-      wss.textAll(state);
+  }
+
+  // retries pushes that could not be allocated, closes the subscribers that
+  // did not answer the last ping and pings the others, half-open connections
+  // of sleeping phones do not hold their slot and queue. Call it from loop().
+  void handle()
+  {
+    if (!wss)
+      return;
+
+    if (unsent)
+      broadcast();
+
+    if (millis() - lastSweep < WSS_PING_INTERVAL)
+      return;
+    lastSweep = millis();
+
+    // refused clients that ignored the close, a sweep is long enough to answer it
+    for (auto &r : refused)
+    {
+      if (r.client && lastSweep - r.time >= WSS_PING_INTERVAL)
+        abortRefused(r);
+    }
+
+    for (auto &s : subscribers)
+    {
+      AsyncWebSocketClient *client = s.id ? wss->client(s.id) : nullptr;
+      if (!client)
+      {
+        s.id = 0;
+        continue;
+      }
+
+      if (s.pinging)
+      {
+        // a close handshake would wait on the dead peer as well
+        stats.timeouts++;
+        Serial.printf("[WSS] client %u missed its pong, closing\n", s.id);
+        s.id = 0;
+        client->client()->close(true);
+        continue;
+      }
+
+      s.pinging = true;
+      s.pingTime = lastSweep;
+      stats.pings++;
+      client->ping();
+    }
+  }
+
+  // queue and liveness metrics of every subscriber, behind counts the state
+  // versions the client has not acknowledged yet, rtt is in ms
+  size_t toJSON(Print &out)
+  {
+    uint32_t version = Sprinkler.getVersion();
+    size_t n = out.printf("{\"count\": %zu, \"max\": %u, \"pings\": %u, \"timeouts\": %u, \"refused\": %u, \"clients\": [",
+                          wss->count(), WSS_MAX_CLIENTS, stats.pings, stats.timeouts, stats.refused);
+    const char *separator = "";
+    for (auto &s : subscribers)
+    {
+      AsyncWebSocketClient *client = s.id ? wss->client(s.id) : nullptr;
+      if (!client)
+        continue;
+
+      n += out.printf("%s{\"id\": %u, \"queue\": %zu, \"lag\": %u, \"behind\": %u, \"coalesced\": %u, \"dropped\": %u, \"msgpack\": %s, \"rtt\": %u, \"rtt_avg\": %u}",
+                      separator, s.id, client->queueLength(), client->lag(), version - s.version,
+                      client->coalesced(), client->dropped(), s.msgpack ? "true" : "false", s.rtt, s.rttAverage);
+      separator = ", ";
+    }
+    n += out.print("]}");
+    return n;
+  }
+
+  void setup(AsyncWebSocket &server)
+  {
+    wss = &server;
+
+    Sprinkler.onChange([this](){
+      broadcast();
     });
     
-    wss.onEvent(handleEvent);
+    wss->onEvent([this](AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len) {
+      handleEvent(server, client, type, arg, data, len);
+    });
   }
 };
 
@@ -0,0 +1,88 @@
+#ifndef SPRINKLER_ZONES_H
+#define SPRINKLER_ZONES_H
+
+#include <Arduino.h>
+#include "includes/JsonString.h"
+
+#define SPRINKLER_MAX_ZONES 16
+#define SPRINKLER_ZONE_NAME_SIZE 20
+#define SPRINKLER_ZONES_JSON_SIZE (SPRINKLER_MAX_ZONES * (SPRINKLER_ZONE_NAME_SIZE + 40) + 8)
+
+struct SprinklerZone {
+  uint8_t pin;
+  char name[SPRINKLER_ZONE_NAME_SIZE];
+  unsigned long duration;  // miliseconds, 0 - use the cycle duration
+};
+
+// Fixed-capacity zone table. Zones are added once at construction time,
+// so the run loop never touches the heap.
+class SprinklerZones {
+ private:
+  SprinklerZone zones[SPRINKLER_MAX_ZONES];
+  uint8_t length;
+
+ public:
+  SprinklerZones() : length(0) {
+  }
+
+  bool add(uint8_t pin) {
+    if (length >= SPRINKLER_MAX_ZONES) return false;
+
+    SprinklerZone &zone = zones[length++];
+    zone.pin = pin;
+    zone.duration = 0;
+    snprintf(zone.name, sizeof(zone.name), "Zone %u", length);
+    return true;
+  }
+
+  uint8_t count() const {
+    return length;
+  }
+
+  bool exists(uint8_t index) const {
+    return index < length;
+  }
+
+  SprinklerZone &operator[](uint8_t index) {
+    return zones[index];
+  }
+
+  const SprinklerZone &operator[](uint8_t index) const {
+    return zones[index];
+  }
+
+  // false when nothing changed, a config save is not needed then
+  bool name(uint8_t index, const char *value) {
+    if (!exists(index) || !value || !strlen(value)) return false;
+    if (strncmp(zones[index].name, value, sizeof(zones[index].name) - 1) == 0) return false;
+
+    strncpy(zones[index].name, value, sizeof(zones[index].name) - 1);
+    zones[index].name[sizeof(zones[index].name) - 1] = 0;
+    return true;
+  }
+
+  bool duration(uint8_t index, unsigned long miliseconds) {
+    if (!exists(index) || zones[index].duration == miliseconds) return false;
+
+    zones[index].duration = miliseconds;
+    return true;
+  }
+
+  size_t toJSON(Print &out) const {
+    size_t n = out.print('[');
+    for (uint8_t i = 0; i < length; i++) {
+      n += out.print(i ? ",\r\n " : "\r\n ");
+      n += out.print("{ \"z\": ");
+      n += out.print(i);
+      n += out.print(", \"name\": ");
+      n += printJsonString(out, zones[i].name);
+      n += out.print(", \"d\": ");
+      n += out.print(zones[i].duration / 60000);
+      n += out.print(" }");
+    }
+    n += out.print("\r\n]");
+    return n;
+  }
+};
+
+#endif
@@ -4,96 +4,195 @@
 #include <Arduino.h>
 #include <EEPROM.h>
 #include <Ticker.h>
-#include <TimeAlarms.h>
-#include <vector>
-#include <functional>
 #include "schedule.h"
 #include "sprinkler-device.h"
+#include "includes/MsgPack.h"
 
-typedef std::function<void()> Delegate;
+#define SPRINKLER_MAX_HANDLERS 4
+
+// millisecond clock of the watering engine, a host build may pass its own
+// virtual clock, e.g. -DSPRINKLER_MILLIS=simMillis
+#ifndef SPRINKLER_MILLIS
+#define SPRINKLER_MILLIS millis
+#endif
+#define SPRINKLER_STATE_JSON_SIZE 176
+#define SPRINKLER_STATE_MSGPACK_SIZE 32
+
+// state fields tracked for delta notifications
+typedef enum {
+  sprinklerZones,
+  sprinklerZone,
+  sprinklerTimer,
+  sprinklerStarted,
+  sprinklerPaused,
+  sprinklerTime,     // the clock, minutes since midnight
+  sprinklerFieldsCount
+} SprinklerField_t;
+
+#define SPRINKLER_FIELD(_field_) (1 << (_field_))
+#define SPRINKLER_ALL_FIELDS (SPRINKLER_FIELD(sprinklerFieldsCount) - 1)
+
+// one program of a batch schedule update, -1 leaves the value as it is
+struct ScheduleProgram
+{
+  int hours;
+  int minutes;
+  int duration;
+  int enable;
+};
 
 class SprinklerClass
 {
 private:
 
-  std::vector<Delegate> onChangeEventHandlers;
+  StaticDelegate onChangeEventHandlers[SPRINKLER_MAX_HANDLERS];
+  uint8_t onChangeEventCount;
   SprinklerDevice* device;
   
   unsigned int times;
   unsigned int duration;
+  uint8_t zone;
   unsigned long startTime;
   unsigned long pauseTime;
   Ticker countdown;
 
-  void notify()
+  uint32_t version;
+  uint32_t fieldVersion[sprinklerFieldsCount];
+  bool dirty;
+  int clockMinute;  // the time last published, -1 - none yet
+
+  uint8_t zoneCount()
+  {
+    return device ? device->zones().count() : 0;
+  }
+
+  uint8_t cycleCount()
+  {
+    uint8_t count = zoneCount();
+    if (!times)
+      return 1;
+
+    return times < count ? times : count;
+  }
+
+  unsigned long zoneDuration(uint8_t index)
+  {
+    if (device && device->zones().exists(index) && device->zones()[index].duration)
+    {
+      return device->zones()[index].duration;
+    }
+
+    return duration;
+  }
+
+  unsigned long remaining()
+  {
+    unsigned long total = zoneDuration(zone);
+    if (!startTime || !total)
+      return 0;
+
+    unsigned long elapsed = (pauseTime ? pauseTime : SPRINKLER_MILLIS()) - startTime;
+    return elapsed < total ? total - elapsed : 0;
+  }
+
+  void startZone()
   {
-    for (auto &event : onChangeEventHandlers) // access by reference to avoid copying
-    {  
-      event();
+    Serial.printf("[SPRINKLER] Zone %u started.\n", zone + 1);
+
+    unsigned long total = zoneDuration(zone);
+    if (total)
+      countdown.once_ms(total, &SprinklerClass::countdownHandler, this);
+
+    if (device) device->turnOn(zone);
+    startTime = SPRINKLER_MILLIS();
+    pauseTime = 0;
+  }
+
+  // marks the fields as changed, subscribers are called once from handle()
+  void notify(uint8_t fields = SPRINKLER_ALL_FIELDS)
+  {
+    version++;
+    for (uint8_t field = 0; field < sprinklerFieldsCount; field++)
+    {
+      if (fields & SPRINKLER_FIELD(field))
+      {
+        fieldVersion[field] = version;
+      }
     }
+    dirty = true;
   }
 
-  void handle(ScheduleClass& sdk)
+  bool changed(SprinklerField_t field, uint32_t since)
+  {
+    return !since || fieldVersion[field] > since;
+  }
+
+  void run(ScheduleClass& sdk)
   {
     duration = sdk.getDuration() * 1000 * 60;
 
-    times = 5;
+    times = zoneCount();
 
     start();
   }
 
+  static void countdownHandler(SprinklerClass *sprinkler)
+  {
+    sprinkler->startNextZone();
+  }
+
   void everydayHandler()
   {
-    handle(Schedule);
+    run(Schedule);
   }
 
   void mondayHandler()
   {
-    handle(Schedule.Mon);
+    run(Schedule.Mon);
   }
 
   void tuesdayHandler()
   {
-    handle(Schedule.Tue);
+    run(Schedule.Tue);
   }
 
   void wednsdayHandler()
   {
-    handle(Schedule.Wed);
+    run(Schedule.Wed);
   }
 
   void thursdayHandler()
   {
-    handle(Schedule.Thu);
+    run(Schedule.Thu);
   }
 
   void fridayHandler()
   {
-    handle(Schedule.Fri);
+    run(Schedule.Fri);
   }
 
   void saturdayHandler()
   {
-    handle(Schedule.Sat);
+    run(Schedule.Sat);
   }
 
   void sundayHandler()
   {
-    handle(Schedule.Sun);
+    run(Schedule.Sun);
   }
 
 public:
 
-  SprinklerClass() : times(0), duration(0), startTime(0), pauseTime(0)
+  SprinklerClass() : onChangeEventCount(0), device(nullptr), times(0), duration(0), zone(0), startTime(0), pauseTime(0), version(0), fieldVersion(), dirty(false), clockMinute(-1)
   {
-    Schedule.set(std::bind(&SprinklerClass::everydayHandler, this));
-    Schedule.Sun.set(std::bind(&SprinklerClass::sundayHandler, this));
-    Schedule.Mon.set(std::bind(&SprinklerClass::mondayHandler, this));
-    Schedule.Tue.set(std::bind(&SprinklerClass::tuesdayHandler, this));
-    Schedule.Wed.set(std::bind(&SprinklerClass::wednsdayHandler, this));
-    Schedule.Thu.set(std::bind(&SprinklerClass::thursdayHandler, this));
-    Schedule.Fri.set(std::bind(&SprinklerClass::fridayHandler, this));
-    Schedule.Sat.set(std::bind(&SprinklerClass::saturdayHandler, this));
+    Schedule.set(StaticDelegate::bind<SprinklerClass, &SprinklerClass::everydayHandler>(this));
+    Schedule.Sun.set(StaticDelegate::bind<SprinklerClass, &SprinklerClass::sundayHandler>(this));
+    Schedule.Mon.set(StaticDelegate::bind<SprinklerClass, &SprinklerClass::mondayHandler>(this));
+    Schedule.Tue.set(StaticDelegate::bind<SprinklerClass, &SprinklerClass::tuesdayHandler>(this));
+    Schedule.Wed.set(StaticDelegate::bind<SprinklerClass, &SprinklerClass::wednsdayHandler>(this));
+    Schedule.Thu.set(StaticDelegate::bind<SprinklerClass, &SprinklerClass::thursdayHandler>(this));
+    Schedule.Fri.set(StaticDelegate::bind<SprinklerClass, &SprinklerClass::fridayHandler>(this));
+    Schedule.Sat.set(StaticDelegate::bind<SprinklerClass, &SprinklerClass::saturdayHandler>(this));
   }
 
   void setup(SprinklerDevice& d)
@@ -102,9 +201,13 @@ public:
     device = &d;
   }
 
-  void onChange(Delegate event)
+  bool onChange(StaticDelegate event)
   {
-    onChangeEventHandlers.push_back(event);
+    if (onChangeEventCount >= SPRINKLER_MAX_HANDLERS)
+      return false;
+
+    onChangeEventHandlers[onChangeEventCount++] = event;
+    return true;
   }
 
   unsigned int getDuration()
@@ -115,31 +218,130 @@ public:
   void setDuration(unsigned int miliseconds)
   {
     duration = miliseconds;
-    notify();
+    notify(SPRINKLER_FIELD(sprinklerTimer));
   }
 
   void setTimes(unsigned int number)
   {
     times = number;
-    notify();
+    notify(SPRINKLER_FIELD(sprinklerZones));
+  }
+
+  // dispatches pending changes to the subscribers at most once per loop,
+  // the clock counts as changed when its minute does, an NTP sync included
+  void handle()
+  {
+    time_t t = now();
+    int minutes = hour(t) * 60 + minute(t);
+    if (minutes != clockMinute)
+    {
+      clockMinute = minutes;
+      notify(SPRINKLER_FIELD(sprinklerTime));
+    }
+
+    if (dirty)
+    {
+      dirty = false;
+      for (uint8_t i = 0; i < onChangeEventCount; i++)
+      {  
+        onChangeEventHandlers[i]();
+      }
+    }
+  }
+
+  uint32_t getVersion()
+  {
+    return version;
+  }
+
+  // writes the state, or only the fields changed after the given version
+  size_t toJSON(Print &out, uint32_t since = 0)
+  {
+    size_t n = out.print("{\r\n\"version\":");
+    n += out.print(version);
+    if (changed(sprinklerZones, since))
+    {
+      n += out.print(",\"zones\":");
+      n += out.print(startTime ? cycleCount() : times);
+    }
+    if (changed(sprinklerZone, since))
+    {
+      n += out.print(",\"zone\":");
+      n += out.print(startTime ? (int)zone : -1);
+    }
+    if (changed(sprinklerTimer, since))
+    {
+      n += out.print(",\"timer\":");
+      n += out.print(remaining());
+    }
+    if (changed(sprinklerStarted, since))
+    {
+      n += out.print(", \"on\": ");
+      n += out.print(startTime ? '1' : '0');
+      n += out.print(",\"started\":");
+      n += out.print(startTime ? "true" : "false");
+    }
+    if (changed(sprinklerPaused, since))
+    {
+      n += out.print(",\"paused\":");
+      n += out.print(pauseTime ? "true" : "false");
+    }
+    if (changed(sprinklerTime, since))
+    {
+      n += out.print(",\"time\": \"");
+      n += out.print(hour());
+      n += out.print(':');
+      n += out.print(minute());
+      n += out.print('"');
+    }
+    n += out.print("\r\n}");
+    return n;
   }
 
-  String toJSON()
+  // the same state as a MessagePack map keyed by field ids: 0 version,
+  // 1 zones, 2 zone, 3 timer, 4 started, 5 paused, 6 minutes since midnight
+  size_t toMsgPack(Print &out, uint32_t since = 0)
   {
-    return "{\r\n"
-           "\"zones\":" +
-           (String)(times) + "," +
-           "\"timer\":" +
-           (String)(startTime ? (duration ? duration - (millis() - startTime) + (pauseTime ? (millis() - pauseTime) : 0) : 0) : 0) + "," +
-           " \"on\": " + 
-           (String)(startTime ? "1" : "0") + "," +
-           "\"started\":" +
-           (String)(startTime ? "true" : "false") + "," +
-           "\"paused\":" +
-           (String)(pauseTime ? "true" : "false") + "," +
-           "\"time\": \"" +
-           (String)hour() + ":" + (String)minute() + "\"" +
-           "\r\n}";
+    uint8_t count = 1;
+    for (uint8_t i = 0; i < sprinklerFieldsCount; i++)
+    {
+      count += changed((SprinklerField_t)i, since);
+    }
+
+    size_t n = MsgPack::map(out, count);
+    n += MsgPack::key(out, 0);
+    n += MsgPack::uint32(out, version);
+    if (changed(sprinklerZones, since))
+    {
+      n += MsgPack::key(out, 1 + sprinklerZones);
+      n += MsgPack::uint32(out, startTime ? cycleCount() : times);
+    }
+    if (changed(sprinklerZone, since))
+    {
+      n += MsgPack::key(out, 1 + sprinklerZone);
+      n += MsgPack::int32(out, startTime ? (int)zone : -1);
+    }
+    if (changed(sprinklerTimer, since))
+    {
+      n += MsgPack::key(out, 1 + sprinklerTimer);
+      n += MsgPack::uint32(out, remaining());
+    }
+    if (changed(sprinklerStarted, since))
+    {
+      n += MsgPack::key(out, 1 + sprinklerStarted);
+      n += MsgPack::boolean(out, startTime);
+    }
+    if (changed(sprinklerPaused, since))
+    {
+      n += MsgPack::key(out, 1 + sprinklerPaused);
+      n += MsgPack::boolean(out, pauseTime);
+    }
+    if (changed(sprinklerTime, since))
+    {
+      n += MsgPack::key(out, 1 + sprinklerTime);
+      n += MsgPack::uint32(out, hour() * 60 + minute());
+    }
+    return n;
   }
 
   bool isWatering()
@@ -147,40 +349,68 @@ public:
     return startTime ? true : false;
   }
 
+  bool isPaused()
+  {
+    return pauseTime ? true : false;
+  }
+
+  void toggle()
+  {
+    if (isWatering())
+    {
+      stop();
+    }
+    else
+    {
+      start();
+    }
+  }
+
+  void togglePause()
+  {
+    if (isPaused())
+    {
+      resume();
+    }
+    else
+    {
+      pause();
+    }
+  }
+
   void start()
   {
     Serial.println("Startting...");
 
-     if (duration)
-      countdown.once_ms(duration - 10000, std::bind(&SprinklerClass::startNextZone, this));
+    countdown.detach();
+    if (device) device->turnOff();
 
-    if (device) device->turnOn();
-    startTime = millis();
-    pauseTime = 0;
+    zone = 0;
+    startZone();
     notify();   
   }
 
   void startNextZone()
   {
-    if (times)
+    if (!startTime)
+      return;
+
+    if (device) device->turnOff(zone);
+
+    if (zone + 1 < cycleCount())
     {
-      times--;
+      uint8_t fields = SPRINKLER_FIELD(sprinklerZone) | SPRINKLER_FIELD(sprinklerTimer);
+      if (pauseTime)
+        fields |= SPRINKLER_FIELD(sprinklerPaused);  // the next zone starts unpaused
+
+      zone++;
+      startZone();
+      notify(fields);
     }
-  
-    if (startTime)
+    else
     {
-      if (times)
-      {
-        if (device) device->turnOn();
-        countdown.once(10, std::bind(&SprinklerClass::start, this));
-      }
-      else
-      {
-        stop();
-      }
+      stop();
     }
-
-    notify();  
   }
 
   void stop()
@@ -189,6 +419,7 @@ public:
     
     if (device) device->turnOff();
 
+    zone = 0;
     startTime = 0;
     pauseTime = 0;
     countdown.detach();
@@ -197,21 +428,63 @@ public:
 
   void pause()
   {
-    if (device) device->turnOff();
+    if (!startTime || pauseTime)
+      return;
 
-    pauseTime = millis();
+    countdown.detach();
 
-    notify();  
+    if (device) device->turnOff(zone);
+
+    pauseTime = SPRINKLER_MILLIS();
+
+    notify(SPRINKLER_FIELD(sprinklerPaused) | SPRINKLER_FIELD(sprinklerTimer));  
   }
 
   void resume()
   {
-    if (device) device->turnOn();
+    if (!pauseTime)
+      return;
 
-    startTime += (millis() - pauseTime);
+    unsigned long left = remaining();
+
+    if (device) device->turnOn(zone);
+
+    startTime += (SPRINKLER_MILLIS() - pauseTime);
     pauseTime = 0;
+
+    if (left)
+      countdown.once_ms(left, &SprinklerClass::countdownHandler, this);
     
-    notify();  
+    notify(SPRINKLER_FIELD(sprinklerPaused) | SPRINKLER_FIELD(sprinklerTimer));  
+  }
+
+  size_t zonesToJSON(Print &out)
+  {
+    return device ? device->zones().toJSON(out) : out.print("[]");
+  }
+
+  void setZone(uint8_t index, const char *name, int duration)
+  {
+    // minutes, -1 keeps the duration, bounded to a day like the stored ones
+    if (duration < -1 || duration > (int)(SECS_PER_DAY / SECS_PER_MIN))
+      return;
+
+    if (device && device->zones().exists(index))
+    {
+      bool changed = false;
+
+      if (name && strlen(name))
+        changed |= device->zones().name(index, name);
+
+      if (duration != -1)
+        changed |= device->zones().duration(index, (unsigned long)duration * 60 * 1000);
+
+      if (changed)
+      {
+        device->save();
+        notify(SPRINKLER_FIELD(sprinklerTimer));
+      }
+    }
   }
 
   void schedule(timeDayOfWeek_t day, int hours, int minutes, int duration, int enable)
@@ -244,6 +517,10 @@ public:
         {
           skd.disable();
         }
+      }
+
+      if (hours != -1 || minutes != -1 || duration != -1 || enable != -1)
+      {
         if (device) device->save();
       }
     }
@@ -272,11 +549,82 @@ public:
         {
           Schedule.disable();
         }
+      }
+
+      if (hours != -1 || minutes != -1 || duration != -1 || enable != -1)
+      {
         if (device) device->save();
       }
     }
   }
 
+  static bool isValid(const ScheduleProgram &program)
+  {
+    return program.hours >= -1 && program.hours < 24 &&
+           program.minutes >= -1 && program.minutes < 60 &&
+           program.duration >= -1 && program.duration <= 24 * 60 &&
+           program.enable >= -1 && program.enable <= 1;
+  }
+
+  // applies the whole week at once, [0] - everyday, [dowSunday..dowSaturday] - days,
+  // nothing is changed unless every program is valid
+  bool schedule(const ScheduleProgram (&week)[8])
+  {
+    if (timeStatus() == timeNotSet)
+      return false;
+
+    for (const ScheduleProgram &program : week)
+    {
+      if (!isValid(program))
+        return false;
+    }
+
+    for (int day = (int)dowSunday; day <= (int)dowSaturday; day++)
+    {
+      const ScheduleProgram &program = week[day];
+      ScheduleClass &skd = Schedule.get((timeDayOfWeek_t)day);
+
+      if (program.hours != -1)
+        skd.setHour(program.hours);
+
+      if (program.minutes != -1)
+        skd.setMinute(program.minutes);
+
+      if (program.duration != -1)
+        skd.setDuration(program.duration);
+
+      if (program.enable == 1)
+      {
+        Schedule.disable();
+        skd.enable();
+      }
+      else if (program.enable == 0)
+      {
+        skd.disable();
+      }
+    }
+
+    // the everyday program goes last, enabling it replaces the days
+    const ScheduleProgram &everyday = week[0];
+
+    if (everyday.hours != -1)
+      Schedule.setHour(everyday.hours);
+
+    if (everyday.minutes != -1)
+      Schedule.setMinute(everyday.minutes);
+
+    if (everyday.duration != -1)
+      Schedule.setDuration(everyday.duration);
+
+    if (everyday.enable == 1)
+      Schedule.enable();
+    else if (everyday.enable == 0)
+      Schedule.disable();
+
+    if (device) device->save();
+    return true;
+  }
+
   virtual void reset()
   {
     if (device) device->reset();
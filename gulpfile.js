@@ -25,6 +25,10 @@ gulp.task('webpack', function () {
 
 });
 
+gulp.task('buildAssetVersions', function () {
+    return gulp.src('arduino/html/*.html').pipe(ard.buildAssetVersions()).pipe(gulp.dest('arduino/html'));
+});
+
 gulp.task('inline', function () {
     return gulp.src('arduino/html/*.html')
         .pipe(inline({
@@ -59,6 +63,15 @@ gulp.task('buildHttpJs', function () {
     return gulp.src('.sprinkler/settings.json').pipe(ard.buildHttpJs()).pipe(gulp.dest('arduino/html'));
 });
 
+gulp.task('buildArchive', function () {
+    // the index page is served by the firmware from the injectable, see buildInjectable
+    return gulp.src(['arduino/html/*.gz', '!arduino/html/index.html.gz']).pipe(ard.buildArchive({ name: 'assets' })).pipe(gulp.dest('arduino/html'));
+});
+
+gulp.task('buildInjectable', function () {
+    return gulp.src('arduino/html/index.html').pipe(ard.buildInjectable({ marker: '%SNAPSHOT%' })).pipe(gulp.dest('arduino/html'));
+});
+
 gulp.task('buildVersionHeader', function () {
     return gulp.src('.sprinkler/settings.json').pipe(ard.buildVersionHeader()).pipe(gulp.dest('arduino/html'));
 });
@@ -72,9 +85,11 @@ gulp.task('default', gulp.series(
     'copy',
     'buildConfigJs',
     'webpack',
+    'buildAssetVersions',
     'inline',
     'gzip',
-    'buildHeaders',
+    'buildArchive',
+    'buildInjectable',
     'buildVersionHeader',
     'buildVersion'
 ));
\ No newline at end of file
@@ -1,15 +1,99 @@
 Http = (function () {
+
+    // state and schedule rendered into the page by the device, missing when
+    // the page is served as a plain file
+    var snapshot = (function () {
+        var el = document.getElementById("snapshot");
+        try {
+            return el ? JSON.parse(el.textContent) : null;
+        } catch (e) {
+            return null;
+        }
+    })();
+
+    var served = {};
+
+    // answers the first read of a service from the snapshot, later reads go to the device
+    function fromSnapshot(service) {
+        if (!snapshot || served[service]) {
+            return undefined;
+        }
+
+        var parts = service.split("/");
+        var value;
+        if (service === "/api/state") {
+            value = snapshot.state;
+        } else if (service === "/api/schedule") {
+            value = snapshot.schedule;
+        } else if (parts.length === 4 && parts[2] === "schedule" && snapshot.schedule) {
+            // disabled days are not in the schedule, those are read from the device
+            value = snapshot.schedule[parts[3]];
+        }
+
+        served[service] = true;
+        return value;
+    }
+
+    var commands = {
+        "state": "state", "start": "start", "on": "start", "stop": "stop", "off": "stop",
+        "pause": "pause", "resume": "resume", "schedule": "schedule", "settings": "settings"
+    };
+
+    // the websocket command for an api read, e.g. /api/schedule/mon?h=6 is
+    // { cmd: "schedule", day: "mon", h: 6 }, null when there is none
+    function toCommand(service) {
+        var query = service.split("?");
+        var parts = query[0].split("/");
+        if (parts[1] !== "api" || !commands[parts[2]] || parts.length > (parts[2] === "schedule" ? 4 : 3)) {
+            return null;
+        }
+
+        var args = {};
+        if (parts[3]) {
+            args.day = parts[3];
+        }
+        (query[1] || "").split("&").forEach(function (pair) {
+            var arg = pair.split("=");
+            if (arg[0]) {
+                var value = decodeURIComponent(arg[1] || "");
+                args[arg[0]] = isNaN(value) || value === "" ? value : Number(value);
+            }
+        });
+
+        return { name: commands[parts[2]], args: args };
+    }
+
+    function request(service, onSuccess) {
+        var xhttp = new XMLHttpRequest();
+        xhttp.onreadystatechange = function () {
+            if (this.readyState == 4 && this.status == 200) {
+                onSuccess(JSON.parse(this.responseText));
+            }
+        };
+        xhttp.open('GET', service, true);
+        xhttp.send();
+    }
+
     return {
 
         get: function (service, onSuccess, OnError) {
-            var xhttp = new XMLHttpRequest();
-            xhttp.onreadystatechange = function () {
-                if (this.readyState == 4 && this.status == 200) {
-                    onSuccess(JSON.parse(this.responseText));
-                }
-            };
-            xhttp.open('GET', service, true);
-            xhttp.send();
+            var cached = fromSnapshot(service);
+            if (typeof cached !== "undefined") {
+                setTimeout(function () { onSuccess(cached); }, 0);
+                return;
+            }
+
+            // one frame on the open socket instead of a new connection,
+            // plain http when it is closed or the command fails
+            var command = toCommand(service);
+            if (command && typeof Wss !== "undefined" && Wss.ready()) {
+                Wss.command(command.name, command.args, onSuccess, function () {
+                    request(service, onSuccess);
+                });
+                return;
+            }
+
+            request(service, onSuccess);
         },
 
         post: function (service, json, onSuccess, onError) {
@@ -4,6 +4,67 @@ Wss = (function () {
     var onError = [];
 
     var websock = null;
+    var state = {};
+
+    // commands waiting for their reply, by id
+    var pending = {};
+    var lastId = 0;
+
+    // state frames come as MessagePack maps keyed by field id, see
+    // SprinklerClass::toMsgPack, they are read back into the JSON shape
+    function unpack(buffer) {
+        var view = new DataView(buffer);
+        var offset = 0;
+
+        function read() {
+            var type = view.getUint8(offset++);
+            var value;
+            if (type < 0x80) return type;
+            if (type >= 0xe0) return type - 0x100;
+            if (type === 0xc2) return false;
+            if (type === 0xc3) return true;
+            switch (type) {
+                case 0xcc: value = view.getUint8(offset); offset += 1; return value;
+                case 0xcd: value = view.getUint16(offset); offset += 2; return value;
+                case 0xce: value = view.getUint32(offset); offset += 4; return value;
+                case 0xd0: value = view.getInt8(offset); offset += 1; return value;
+                case 0xd1: value = view.getInt16(offset); offset += 2; return value;
+                case 0xd2: value = view.getInt32(offset); offset += 4; return value;
+            }
+            throw new Error("WS: unexpected type " + type);
+        }
+
+        var fields = {};
+        var count = view.getUint8(offset++) & 0x0f;
+        while (count--) {
+            var key = read();
+            fields[key] = read();
+        }
+
+        var delta = { version: fields[0] };
+        if (fields[1] !== undefined) delta.zones = fields[1];
+        if (fields[2] !== undefined) delta.zone = fields[2];
+        if (fields[3] !== undefined) delta.timer = fields[3];
+        if (fields[4] !== undefined) { delta.on = fields[4] ? 1 : 0; delta.started = fields[4]; }
+        if (fields[5] !== undefined) delta.paused = fields[5];
+        if (fields[6] !== undefined) delta.time = Math.floor(fields[6] / 60) + ":" + fields[6] % 60;
+        return delta;
+    }
+
+    function settle(id, error, result) {
+        var command = pending[id];
+        if (!command) {
+            return;
+        }
+
+        delete pending[id];
+        clearTimeout(command.timer);
+        if (error) {
+            command.onError && command.onError(error);
+        } else {
+            command.onSuccess && command.onSuccess(result);
+        }
+    }
 
     return {
 
@@ -12,8 +73,18 @@ Wss = (function () {
             if (!websock && window.location.hostname)
             {
                 websock = new WebSocket('ws://' + window.location.hostname + ':80/ws');
-                websock.onopen = function (evt) { console.log('WS: open'); };
-                websock.onclose = function (evt) { console.log('WS: close'); };
+                websock.binaryType = 'arraybuffer';
+                websock.onopen = function (evt) {
+                    console.log('WS: open');
+                    state = {};
+                    websock.send(JSON.stringify({ enc: 'msgpack' }));
+                };
+                websock.onclose = function (evt) {
+                    console.log('WS: close');
+                    for (var id in pending) {
+                        settle(id, "closed");
+                    }
+                };
             
                 websock.onerror = function (evt) {
                     console.log("WS: error");
@@ -27,7 +98,22 @@ Wss = (function () {
                 websock.onmessage = function (evt) {
                     console.log(evt);
             
-                    var state = JSON.parse(evt.data);
+                    // replies carry the id of their command, state pushes do not
+                    var delta = typeof evt.data === 'string' ? JSON.parse(evt.data) : unpack(evt.data);
+                    if (delta.id !== undefined) {
+                        settle(delta.id, delta.error, delta.result);
+                        return;
+                    }
+
+                    // the device sends the full state once, then only the fields
+                    // changed since the version we acknowledged last
+                    for (var key in delta) {
+                        state[key] = delta[key];
+                    }
+                    if (delta.version !== undefined) {
+                        websock.send(JSON.stringify({ ack: delta.version }));
+                    }
+
                     onSuccess.forEach(function (callback) {
                         callback(state);
                     }, this);
@@ -41,6 +127,31 @@ Wss = (function () {
             if (onErrorCallback) {
                 onError.push(onErrorCallback);
             }
+        },
+
+        ready: function () {
+            return websock !== null && websock.readyState === WebSocket.OPEN;
+        },
+
+        // runs a command on the open socket: state, start, stop, pause, resume,
+        // schedule or settings, with the same arguments as the http api
+        command: function (name, args, onSuccessCallback, onErrorCallback) {
+            if (!this.ready()) {
+                onErrorCallback && onErrorCallback("closed");
+                return;
+            }
+
+            var message = { id: ++lastId, cmd: name };
+            for (var key in args) {
+                message[key] = args[key];
+            }
+
+            pending[message.id] = {
+                onSuccess: onSuccessCallback,
+                onError: onErrorCallback,
+                timer: setTimeout(function () { settle(message.id, "timeout"); }, 5000)
+            };
+            websock.send(JSON.stringify(message));
         }
     }
 })();
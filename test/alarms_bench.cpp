@@ -0,0 +1,70 @@
+// Services a full pool of alarms for one simulated day, one second at a time,
+// and reports the cost of serviceAlarms() and getNextTrigger(). Built once per
+// backend and pool size (see the Makefile), the fired count and checksum must
+// agree between the linear and heap builds of the same size.
+
+#include <Arduino.h>
+#include <chrono>
+// serviceAlarms() is private and Alarm.delay() spins until millis() moves,
+// which the virtual clock never does on its own
+#define private public
+#include <TimeAlarms.h>
+#undef private
+
+#ifndef BACKEND
+#define BACKEND "?"
+#endif
+
+static uint32_t fired;
+static uint32_t checksum;
+
+static void tick()
+{
+  fired++;
+  checksum += (Alarm.getTriggeredAlarmId() + 1) * (uint32_t)now();  // order free, the backends may differ within a second
+}
+
+int main()
+{
+  tmElements_t start = {0, 0, 6, 2, 5, 4, 2021 - 1970};  // Mon 5 Apr 2021 06:00:00
+  setTime(makeTime(start));
+
+  srand(dtNBR_ALARMS);
+  for (int i = 0; i < dtNBR_ALARMS; i++)
+  {
+    // half interval timers, half daily alarms, like a busy schedule would be
+    AlarmID_t id = i % 2
+                       ? Alarm.timerRepeat(1 + random(3600), tick)
+                       : Alarm.alarmRepeat(random(SECS_PER_DAY), tick);
+    if (id == dtINVALID_ALARM_ID)
+    {
+      printf("alarm %d not created\n", i);
+      return 1;
+    }
+  }
+
+  typedef std::chrono::steady_clock clock;
+  clock::duration service(0), next(0);
+  time_t soonest = 0;
+  const uint32_t steps = SECS_PER_DAY;
+  for (uint32_t i = 0; i < steps; i++)
+  {
+    shimAdvance(1000);
+
+    clock::time_point begin = clock::now();
+    Alarm.serviceAlarms();
+    clock::time_point middle = clock::now();
+    soonest += Alarm.getNextTrigger();
+    clock::time_point end = clock::now();
+
+    service += middle - begin;
+    next += end - middle;
+  }
+
+  printf("%-6s %5d alarms: service %8.1f ns/call, next trigger %8.1f ns/call, fired %u, checksum %08x/%04lx\n",
+         BACKEND, dtNBR_ALARMS,
+         std::chrono::duration<double, std::nano>(service).count() / steps,
+         std::chrono::duration<double, std::nano>(next).count() / steps,
+         fired, checksum, (unsigned long)(soonest & 0xffff));
+  return 0;
+}
@@ -0,0 +1,162 @@
+// Heap and time of pushing a state change to 1, 4 and 8 WebSocket
+// dashboards, every one of which has acknowledged the previous version. The
+// firmware serialized and copied the frame once per client before, it now
+// serializes it once into a buffer the client queues share. Every client
+// still allocates its own message and queue node, a lone client gets a plain
+// copy as before. Measured from the change to the last frame acknowledged,
+// with the library's send path.
+
+#define WSS_MAX_CLIENTS 8
+
+#include <Arduino.h>
+#include <Ticker.h>
+#include <TimeLib.h>
+#include <chrono>
+#include "Heap.h"
+#include <ESPAsyncWebServer.h>
+#include "sprinkler.h"
+#include "sprinkler-device.h"
+
+extern SprinklerDevice Device = SprinklerDevice([] {}, 13, {12, 14, 15});
+
+// the bench stands in for the acks and calls broadcast() directly, the
+// event log is left out
+#undef os_printf
+#define os_printf(...)
+#define private public
+#include "sprinkler-wss.h"
+#undef private
+
+#define ADDRESS 0x6404a8c0  // 192.168.4.100
+#define CHANGES 10000
+
+static AsyncWebSocket *ws = new AsyncWebSocket("/ws");  // the server deletes its handlers
+static SprinklerWss wss;
+
+// the broadcast before, verbatim apart from being a free function
+static void send(AsyncWebSocketClient *client, SprinklerSubscriber *s, uint32_t since)
+{
+  if (s->msgpack)
+  {
+    PrintBuffer<SPRINKLER_STATE_MSGPACK_SIZE> state;
+    Sprinkler.toMsgPack(state, since);
+    client->binary(state.c_str(), state.length());
+  }
+  else
+  {
+    PrintBuffer<SPRINKLER_STATE_JSON_SIZE> state;
+    Sprinkler.toJSON(state, since);
+    client->text(state.c_str(), state.length());
+  }
+}
+
+static void before()
+{
+  uint32_t version = Sprinkler.getVersion();
+  for (auto &s : wss.subscribers)
+  {
+    if (!s.id || s.version == version)
+      continue;
+
+    AsyncWebSocketClient *client = ws->client(s.id);
+    if (!client)
+    {
+      s.id = 0;
+      continue;
+    }
+
+    send(client, &s, s.version);
+  }
+}
+
+struct Sample
+{
+  double ns;
+  double allocs;
+  double allocated;
+  size_t peak;
+  size_t frames;
+};
+
+template <typename Broadcast>
+static Sample run(ShimPeer **peers, int clients, Broadcast broadcast)
+{
+  Sample sample = {};
+  size_t base = shimHeap.live;
+  shimHeap.reset();
+
+  typedef std::chrono::steady_clock clock;
+  clock::time_point begin = clock::now();
+  for (int i = 0; i < CHANGES; i++)
+  {
+    Sprinkler.setDuration(15 * 60 * 1000 + i % 2);
+    broadcast();
+    for (int c = 0; c < clients; c++)
+    {
+      sample.frames += peers[c]->ack();
+      peers[c]->drop();
+    }
+    // the dashboards acknowledge the version they got
+    for (auto &s : wss.subscribers)
+      s.version = Sprinkler.getVersion();
+  }
+  sample.ns = std::chrono::duration<double, std::nano>(clock::now() - begin).count() / CHANGES;
+
+  sample.allocs = (double)shimHeap.allocs / CHANGES;
+  sample.allocated = (double)shimHeap.allocated / CHANGES;
+  sample.peak = shimHeap.peak - base;
+  sample.frames /= CHANGES * clients;
+  return sample;
+}
+
+static void report(const char *how, int clients, const Sample &s)
+{
+  printf("%-7s %d clients: %5.0f ns, %4.1f allocations, %4.0f bytes allocated per change, peak %4zu bytes, %zu bytes a frame\n",
+         how, clients, s.ns, s.allocs, s.allocated, s.peak, s.frames);
+}
+
+int main()
+{
+  tmElements_t start = {0, 30, 7, 2, 5, 4, 2021 - 1970};  // Mon 5 Apr 2021 07:30:00
+  setTime(makeTime(start));
+  Sprinkler.setup(Device);
+
+  AsyncWebServer server(80);
+  wss.setup(*ws);
+  server.addHandler(ws);
+  server.begin();
+
+  static const int counts[] = {1, 4, 8};
+  for (int clients : counts)
+  {
+    ShimPeer *peers[WSS_MAX_CLIENTS];
+    for (int c = 0; c < clients; c++)
+    {
+      peers[c] = ShimPeer::connect(80, ADDRESS + c * 0x01000000);
+      peers[c]->send("GET /ws HTTP/1.1\r\nHost: sprinkler\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                     "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n");
+      // the upgrade response and the state frame sent on connect
+      for (int i = 0; i < 4; i++)
+      {
+        peers[c]->ack();
+        peers[c]->poll();
+      }
+      peers[c]->drop();
+    }
+    if (ws->count() != (size_t)clients)
+    {
+      printf("%zu of %d clients connected\n", ws->count(), clients);
+      return 1;
+    }
+
+    run(peers, clients, [] { wss.broadcast(); });  // warm up
+    report("before", clients, run(peers, clients, before));
+    report("shared", clients, run(peers, clients, [] { wss.broadcast(); }));
+
+    for (int c = 0; c < clients; c++)
+    {
+      delete peers[c];
+    }
+  }
+  return 0;
+}
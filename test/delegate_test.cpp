@@ -0,0 +1,152 @@
+// Runs a week of scheduled watering cycles on a three zone device, with the
+// button pausing, resuming and skipping zones, and checks that none of it
+// touches the heap: schedule events, countdown ticks, button gestures and
+// change notifications all go through StaticDelegate. Then the clock has to
+// reach clients as a delta, and a burst of contact chatter overflows the
+// button's edge queue.
+
+#include <Arduino.h>
+#include "Heap.h"
+#include "sprinkler.h"
+#include "sprinkler-device.h"
+#include "includes/ButtonEvents.h"
+#include "includes/PrintBuffer.h"
+
+#define BTN_PIN 0
+#define LED_PIN 13
+
+extern SprinklerDevice Device = SprinklerDevice([]() {
+  pinMode(LED_PIN, OUTPUT);
+  pinMode(BTN_PIN, INPUT);
+
+  Button.onShortPress(StaticDelegate::bind<SprinklerClass, &SprinklerClass::toggle>(&Sprinkler));
+  Button.onLongPress(StaticDelegate::bind<SprinklerClass, &SprinklerClass::togglePause>(&Sprinkler));
+  Button.onDoublePress(StaticDelegate::bind<SprinklerClass, &SprinklerClass::startNextZone>(&Sprinkler));
+  Button.setup(BTN_PIN);
+}, LED_PIN, {12, 14, 15});
+
+static uint32_t transitions;
+static uint32_t notifications;
+
+static void loop()
+{
+  Schedule.handle();
+  Sprinkler.handle();
+  Button.handle();
+  Device.handle();
+}
+
+static void run(unsigned long ms)
+{
+  for (unsigned long i = 0; i < ms; i += 10)
+  {
+    shimAdvance(10);
+    loop();
+  }
+}
+
+static void press(unsigned long ms)
+{
+  shimInterrupt(BTN_PIN, LOW);
+  run(ms);
+  shimInterrupt(BTN_PIN, HIGH);
+  run(50);
+}
+
+static bool check(bool condition, const char *what)
+{
+  if (!condition)
+    printf("FAIL: %s\n", what);
+  return condition;
+}
+
+// one watering cycle: the 07:00 program, a pause and resume, a skipped zone
+static bool cycle()
+{
+  bool ok = true;
+  time_t t = now();
+  run((previousMidnight(t) + AlarmHMS(7, 0, 30) - t) * 1000);
+  ok &= check(Sprinkler.isWatering(), "program started");
+
+  press(1200);  // long press pauses
+  ok &= check(Sprinkler.isPaused(), "long press pauses");
+  run(10000);
+  press(1200);  // and resumes
+  ok &= check(!Sprinkler.isPaused(), "long press resumes");
+
+  press(80);  // double press skips to the next zone
+  run(100);
+  press(80);
+  run(1000);
+
+  run(8 * 60 * 1000L);  // the remaining zones run out
+  ok &= check(!Sprinkler.isWatering(), "program finished");
+
+  t = now();
+  run((nextMidnight(t) - t) * 1000);  // and the rest of the day
+  return ok;
+}
+
+// a client that has the current version gets the time with the next minute
+static bool clockDelta()
+{
+  uint32_t version = Sprinkler.getVersion();
+  run(60 * 1000L);
+  PrintBuffer<SPRINKLER_STATE_JSON_SIZE> delta;
+  Sprinkler.toJSON(delta, version);
+  return check(strstr(delta.c_str(), "\"time\"") != nullptr, "the minute changes the time field");
+}
+
+// more edges than the queue holds, the last queued one pressed and the pin
+// released, the next press has to work as usual
+static bool chatter()
+{
+  for (int i = 0; i < 2 * BUTTON_QUEUE_SIZE; i++)
+    shimInterrupt(BTN_PIN, i % 2 ? HIGH : LOW);
+  run(2000);
+  bool ok = check(!Sprinkler.isWatering() && !Sprinkler.isPaused(), "dropped edges make no gesture");
+
+  press(80);  // short press starts
+  run(1000);
+  ok &= check(Sprinkler.isWatering(), "the button works after dropped edges");
+  Sprinkler.stop();
+  return ok;
+}
+
+int main()
+{
+  tmElements_t start = {0, 0, 6, 2, 5, 4, 2021 - 1970};  // Mon 5 Apr 2021 06:00:00
+  setTime(makeTime(start));
+
+  shimInterrupt(BTN_PIN, HIGH);  // released, the button is active low
+  shimWatchPins([](uint8_t pin, uint8_t) {
+    if (pin != LED_PIN)
+      transitions++;
+  });
+
+  Device.setup();
+  Sprinkler.setup(Device);
+  Sprinkler.onChange([] { notifications++; });
+  for (uint8_t i = 0; i < 3; i++)
+    Sprinkler.setZone(i, "zone", 3);  // minutes
+  Sprinkler.schedule(7, 0, 3, 1);
+
+  // the first cycle may still commit the config and warm up the logs
+  bool ok = cycle();
+
+  const int days = 7;
+  shimHeap.reset();
+  uint32_t before = transitions;
+  for (int day = 0; day < days; day++)
+    ok &= cycle();
+
+  ShimHeap heap = shimHeap;  // before stdio allocates its buffer
+
+  printf("%d cycles: %u valve transitions, %u notifications, %u allocations, %llu bytes\n",
+         days, transitions - before, notifications, heap.allocs, (unsigned long long)heap.allocated);
+  ok &= check(transitions - before == days * 8, "every zone switched on and off, twice for the paused one");
+  ok &= check(heap.allocs == 0, "no heap allocation per watering cycle");
+  ok &= clockDelta();
+  ok &= chatter();
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,112 @@
+// A gzipped asset served to several browsers at once, through the library's
+// AsyncProgmemResponse the firmware used before and AsyncFlashResponse it
+// uses now. Each browser acknowledges its whole window per round, as a
+// delayed ACK of two segments does. The host clock measures the copies and
+// the allocator, not the flash reads of the device. lwIP's pbufs are not
+// counted on either side, the peers keep what they receive off the heap.
+// Neither response is zero-copy: both copy every byte out of flash into a RAM
+// buffer and from there into a pbuf. What differs is where that buffer lives.
+
+#include <Arduino.h>
+#include <chrono>
+#include "Heap.h"
+#include <ESPAsyncWebServer.h>
+#include "includes/AsyncFlashResponse.h"
+
+#define ADDRESS 0x6404a8c0  // 192.168.4.100
+#define ASSET_SIZE 65536
+#define BROWSERS 4
+#define ROUNDS 50
+
+static uint8_t asset[ASSET_SIZE] PROGMEM;
+
+struct Sample
+{
+  double ns;
+  uint32_t acks;
+  double allocs;
+  double allocated;
+  size_t peak;
+  bool complete;
+};
+
+static bool flash;
+
+static void respond(AsyncWebServerRequest *request)
+{
+  AsyncWebServerResponse *response;
+  if (flash)
+    response = new AsyncFlashResponse(200, "application/javascript", asset, sizeof(asset));
+  else
+    response = request->beginResponse_P(200, "application/javascript", asset, sizeof(asset));
+  response->addHeader("Content-Encoding", "gzip");
+  request->send(response);
+}
+
+// ROUNDS times, BROWSERS download the asset side by side
+static Sample run(bool useFlash)
+{
+  flash = useFlash;
+  Sample sample = {};
+  ShimPeer *peers[BROWSERS];
+  size_t base = shimHeap.live;
+  shimHeap.reset();
+
+  typedef std::chrono::steady_clock clock;
+  clock::time_point begin = clock::now();
+  sample.complete = true;
+  for (int round = 0; round < ROUNDS; round++)
+  {
+    for (int i = 0; i < BROWSERS; i++)
+    {
+      peers[i] = ShimPeer::connect(80, ADDRESS + i * 0x01000000);
+      peers[i]->send("GET /app.js HTTP/1.1\r\nHost: sprinkler\r\nAccept-Encoding: gzip\r\nConnection: close\r\n\r\n");
+    }
+    for (bool sending = true; sending;)
+    {
+      sending = false;
+      for (ShimPeer *peer : peers)
+      {
+        if (peer->ack())
+        {
+          sample.acks++;
+          sending = true;
+        }
+        peer->drop();
+      }
+    }
+    for (ShimPeer *peer : peers)
+    {
+      sample.complete &= peer->total > ASSET_SIZE;
+      delete peer;
+    }
+  }
+  sample.ns = std::chrono::duration<double, std::nano>(clock::now() - begin).count();
+
+  sample.allocs = (double)shimHeap.allocs / ROUNDS / BROWSERS;
+  sample.allocated = (double)shimHeap.allocated / ROUNDS / BROWSERS;
+  sample.peak = shimHeap.peak - base;
+  return sample;
+}
+
+static void report(const char *how, const Sample &s)
+{
+  printf("%-22s %d x %d KB: %6.0f MB/s, %3u acks, %6.1f allocations, %6.0f bytes allocated per download, peak %5zu bytes%s\n",
+         how, BROWSERS, ASSET_SIZE / 1024, (double)ASSET_SIZE * BROWSERS * ROUNDS / s.ns * 1e3,
+         s.acks / ROUNDS / BROWSERS, s.allocs, s.allocated, s.peak, s.complete ? "" : ", incomplete");
+}
+
+int main()
+{
+  for (size_t i = 0; i < sizeof(asset); i++)
+    asset[i] = rand();
+
+  AsyncWebServer server(80);
+  server.on("/app.js", HTTP_GET, respond);
+  server.begin();
+
+  run(true);  // warm up
+  report("AsyncProgmemResponse", run(false));
+  report("AsyncFlashResponse", run(true));
+  return 0;
+}
@@ -0,0 +1,14 @@
+// stand-in for the archive buildArchive generates: one small text asset
+static const char SKETCH_ASSETS_STR_0[] PROGMEM = "/test.txt";
+static const char SKETCH_ASSETS_STR_1[] PROGMEM = "text/plain";
+static const char SKETCH_ASSETS_STR_2[] PROGMEM = "\"0000000000000000\"";
+static const char SKETCH_ASSETS_STR_3[] PROGMEM = "";
+
+const uint8_t SKETCH_ASSETS[] PROGMEM __attribute__((aligned(4))) = {
+0x74,0x65,0x73,0x74,0x0a,0x00,0x00,0x00
+};
+
+#define SKETCH_ASSETS_COUNT 1
+const AssetEntry SKETCH_ASSETS_INDEX[] PROGMEM = {
+  {SKETCH_ASSETS_STR_0, SKETCH_ASSETS_STR_1, 0, 5, SKETCH_ASSETS_STR_2, SKETCH_ASSETS_STR_3},
+};
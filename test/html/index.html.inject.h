@@ -0,0 +1,8 @@
+// stand-in for the page buildInjectable generates, empty halves
+const uint8_t SKETCH_INDEX_HTML_HEAD[] PROGMEM __attribute__((aligned(4))) = {0x00};
+const uint8_t SKETCH_INDEX_HTML_TAIL[] PROGMEM __attribute__((aligned(4))) = {0x00};
+const InjectedAsset SKETCH_INDEX_HTML_INJECT = {
+  SKETCH_INDEX_HTML_HEAD, 0, 0, 0x00000000,
+  SKETCH_INDEX_HTML_TAIL, 0, 0, 0x00000000, 0x00000000,
+  "0000000000000000"
+};
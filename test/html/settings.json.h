@@ -0,0 +1,7 @@
+// stand-in for the header buildVersionHeader generates, the host builds only
+// reach it when arduino/html was not generated
+#define SKETCH_VERSION_MAJOR 0
+#define SKETCH_VERSION_MINOR 0
+#define SKETCH_VERSION_RELEASE 0
+#define SKETCH_VERSION_BUILD 0
+#define SKETCH_VERSION "0.0.0"
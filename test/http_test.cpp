@@ -0,0 +1,269 @@
+// The admission server on loopback connections: kept-alive connections,
+// refusals in the middle of one, 503 on a full in flight budget and on a low
+// heap, the held budget, and a WebSocket upgrade handing its connection over.
+// Built with AddressSanitizer, a callback into a deleted request fails it.
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+#include <ESPAsyncWebServer.h>
+#include "includes/AsyncAdmissionServer.h"
+#include "Heap.h"
+
+#define ADDRESS 0x0104a8c0  // 192.168.4.1
+
+static bool check(bool condition, const char *what)
+{
+  if (!condition)
+    printf("FAIL: %s\n", what);
+  return condition;
+}
+
+static const char *request(bool keepAlive)
+{
+  return keepAlive ? "GET /state HTTP/1.1\r\nHost: sprinkler\r\n\r\n"
+                   : "GET /state HTTP/1.1\r\nHost: sprinkler\r\nConnection: close\r\n\r\n";
+}
+
+// acks and polls until the server has nothing left to say
+static void settle(ShimPeer *peer)
+{
+  for (int i = 0; i < 8 && peer->open(); i++)
+  {
+    peer->ack();
+    peer->poll();
+  }
+}
+
+static int responses(ShimPeer *peer, const char *status)
+{
+  int n = 0;
+  for (const char *at = peer->received(); (at = strstr(at, status)); at++)
+    n++;
+  return n;
+}
+
+static std::vector<AsyncWebServerRequest *> held;
+
+static void setup(AsyncAdmissionServer &server)
+{
+  server.on("/state", HTTP_GET, [](AsyncWebServerRequest *request) {
+    request->send(200, "application/json", "{\"on\": 0}");
+  });
+  server.on("/wait", HTTP_GET, [&server](AsyncWebServerRequest *request) {
+    if (!server.hold(request))
+      return request->send(304);
+    held.push_back(request);
+    request->onDisconnect([request]() {
+      held.erase(std::find(held.begin(), held.end(), request));
+    });
+  });
+  server.begin();
+}
+
+static bool keepAlive()
+{
+  bool ok = true;
+  AsyncAdmissionServer server(80);
+  setup(server);
+
+  ShimPeer *peer = ShimPeer::connect(80, ADDRESS);
+  for (int i = 0; i < 3; i++)
+  {
+    peer->send(request(true));
+    settle(peer);
+    shimAdvance(1000);
+  }
+  ok &= check(responses(peer, "HTTP/1.1 200") == 3, "three requests answered on one connection");
+  ok &= check(peer->open(), "the connection stays open between requests");
+  ok &= check(server.getStats().active == 0, "an idle kept-alive connection is not in flight");
+
+  // two requests in one segment, the second waits for the first
+  peer->send((std::string(request(true)) + request(false)).c_str());
+  settle(peer);
+  ok &= check(responses(peer, "HTTP/1.1 200") == 5, "a pipelined request is answered after the first");
+  ok &= check(responses(peer, "Connection: close") == 1, "the last response closes the connection");
+
+  // the browser closes on Connection: close
+  delete peer;
+  ok &= check(server.getStats().active == 0, "nothing is in flight after the connection closed");
+  return ok;
+}
+
+// the rate limit refuses the next request of a kept-alive connection once the
+// previous request object is gone, the client must not call back into it
+static bool refusedKeepAlive()
+{
+  bool ok = true;
+  AsyncAdmissionServer server(80);
+  setup(server);
+
+  ShimPeer *peer = ShimPeer::connect(80, ADDRESS);
+  for (int i = 0; i < ADMISSION_BURST; i++)
+  {
+    peer->send(request(true));
+    settle(peer);
+  }
+  ok &= check(responses(peer, "HTTP/1.1 200") == ADMISSION_BURST, "the burst is answered");
+  ok &= check(peer->open(), "the refused connection waits for its next request");
+
+  for (int i = 0; i < 4; i++)
+  {
+    peer->ack();
+    peer->poll();
+  }
+  peer->send(request(true));
+  settle(peer);
+  ok &= check(responses(peer, "HTTP/1.1 429") == 1, "the next request is answered 429");
+  ok &= check(!peer->open(), "the refused connection is closed");
+  delete peer;
+  return ok;
+}
+
+// requests stalled in their headers use up the in flight budget, the next
+// connection is refused before a request is allocated for it
+static bool overloaded()
+{
+  bool ok = true;
+  AsyncAdmissionServer server(80);
+  setup(server);
+
+  ShimPeer *stalled[ADMISSION_MAX_REQUESTS];
+  for (ShimPeer *&peer : stalled)
+  {
+    peer = ShimPeer::connect(80, ADDRESS + (&peer - stalled + 1) * 0x01000000);
+    peer->send("GET /state HTTP/1.1\r\nHost: sprinkler\r\n");
+    settle(peer);
+  }
+  ok &= check(server.getStats().active == ADMISSION_MAX_REQUESTS, "half-sent requests are in flight");
+
+  ShimPeer *last = ShimPeer::connect(80, ADDRESS + 0x20000000);
+  last->send(request(true));
+  settle(last);
+  ok &= check(responses(last, "HTTP/1.1 503") == 1, "one more request is answered 503");
+  ok &= check(strstr(last->received(), "Retry-After: 2") != nullptr, "the 503 asks to retry later");
+  ok &= check(!last->open(), "the refused connection is closed");
+  ok &= check(server.getStats().rejected == 1 && server.getStats().shed == 0, "the refusal counts as rejected");
+  delete last;
+
+  // finishing one stalled request makes room again
+  stalled[0]->send("\r\n");
+  settle(stalled[0]);
+  ok &= check(responses(stalled[0], "HTTP/1.1 200") == 1, "the stalled request is answered once complete");
+  last = ShimPeer::connect(80, ADDRESS + 0x20000000);
+  last->send(request(false));
+  settle(last);
+  ok &= check(responses(last, "HTTP/1.1 200") == 1, "a finished request leaves the in flight budget");
+
+  for (ShimPeer *peer : stalled)
+    delete peer;
+  delete last;
+  ok &= check(server.getStats().active == 0, "nothing is in flight after the connections closed");
+  return ok;
+}
+
+// below ADMISSION_MIN_HEAP new connections are shed whatever the budgets say.
+// Built without the counting heap, so the live bytes are set by hand.
+static bool shedding()
+{
+  bool ok = true;
+  AsyncAdmissionServer server(80);
+  setup(server);
+
+  shimHeap.live = SHIM_HEAP_SIZE - ADMISSION_MIN_HEAP + 1;
+  ShimPeer *peer = ShimPeer::connect(80, ADDRESS);
+  peer->send(request(true));
+  settle(peer);
+  ok &= check(responses(peer, "HTTP/1.1 503") == 1, "a low heap answers 503");
+  ok &= check(server.getStats().shed == 1 && server.getStats().rejected == 0, "the refusal counts as shed");
+  ok &= check(server.getStats().accepted == 0, "no request is allocated");
+  delete peer;
+
+  shimHeap.live = 0;
+  peer = ShimPeer::connect(80, ADDRESS);
+  peer->send(request(false));
+  settle(peer);
+  ok &= check(responses(peer, "HTTP/1.1 200") == 1, "requests are admitted once the heap recovers");
+  delete peer;
+  return ok;
+}
+
+// long-polls are held apart, the in flight budget stays free for the rest
+static bool heldBudget()
+{
+  bool ok = true;
+  AsyncAdmissionServer server(80);
+  setup(server);
+
+  ShimPeer *waiting[ADMISSION_MAX_HELD + 1];
+  for (ShimPeer *&peer : waiting)
+  {
+    peer = ShimPeer::connect(80, ADDRESS + (&peer - waiting + 1) * 0x01000000);
+    peer->send("GET /wait HTTP/1.1\r\n\r\n");
+    settle(peer);
+  }
+  ok &= check(held.size() == ADMISSION_MAX_HELD, "hold() takes up to ADMISSION_MAX_HELD requests");
+  ok &= check(responses(waiting[ADMISSION_MAX_HELD], "HTTP/1.1 304") == 1, "one more is answered right away");
+  ok &= check(server.getStats().held == ADMISSION_MAX_HELD && server.getStats().active == 0, "held requests are not in flight");
+
+  // past the receive timeout the server set on the connection
+  shimAdvance(10000);
+  for (ShimPeer *peer : waiting)
+    settle(peer);
+  ok &= check(held.size() == ADMISSION_MAX_HELD && waiting[0]->open(), "held requests outlive the receive timeout");
+
+  ShimPeer *idle[ADMISSION_MAX_REQUESTS];
+  for (ShimPeer *&peer : idle)
+  {
+    peer = ShimPeer::connect(80, ADDRESS + (&peer - idle + 10) * 0x01000000);
+    peer->send(request(true));
+    settle(peer);
+  }
+  ShimPeer *last = ShimPeer::connect(80, ADDRESS + 0x20000000);
+  last->send(request(false));
+  settle(last);
+  ok &= check(responses(last, "HTTP/1.1 200") == 1, "idle kept-alive connections leave room for a new one");
+
+  for (ShimPeer *peer : waiting)
+    delete peer;
+  for (ShimPeer *peer : idle)
+    delete peer;
+  delete last;
+  ok &= check(held.empty() && server.getStats().held == 0, "disconnected long-polls leave the held budget");
+  return ok;
+}
+
+// the upgrade response deletes its request once acknowledged, the request
+// must not look at itself after
+static bool webSocketUpgrade()
+{
+  bool ok = true;
+  AsyncAdmissionServer server(80);
+  AsyncWebSocket *ws = new AsyncWebSocket("/ws");  // the server deletes its handlers
+  server.addHandler(ws);
+  setup(server);
+
+  ShimPeer *peer = ShimPeer::connect(80, ADDRESS);
+  peer->send("GET /ws HTTP/1.1\r\nHost: sprinkler\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+             "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n");
+  settle(peer);
+  ok &= check(responses(peer, "HTTP/1.1 101") == 1, "the upgrade is answered");
+  ok &= check(strstr(peer->received(), "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") != nullptr, "the key is accepted");
+  ok &= check(ws->count() == 1 && peer->open(), "the connection belongs to the WebSocket client");
+  ok &= check(server.getStats().active == 0, "the upgraded request is not in flight");
+
+  delete peer;
+  ok &= check(ws->count() == 0, "the WebSocket client is gone with the connection");
+  return ok;
+}
+
+int main()
+{
+  bool ok = keepAlive();
+  ok &= refusedKeepAlive();
+  ok &= overloaded();
+  ok &= shedding();
+  ok &= heldBudget();
+  ok &= webSocketUpgrade();
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,253 @@
+// The config journal on the emulated flash. First the power is cut at every
+// flash operation of a compaction in turn: whatever was acknowledged must
+// read back, in the same boot and after a remount. Then a year of UI edits
+// goes through SprinklerDevice and the erases per sector are counted against
+// what rewriting the EEPROM sector on every edit cost. Last, a save that the
+// flash fails has to stay pending until a later handle() writes it.
+
+#include <Arduino.h>
+#include <flash_hal.h>
+#include "sprinkler.h"
+#include "sprinkler-device.h"
+#include "includes/PrintBuffer.h"
+
+extern SprinklerDevice Device = SprinklerDevice([] {}, 13, {12, 14, 15});
+
+#define FIRST_SECTOR (SHIM_FLASH_FIRST + SHIM_FLASH_SECTORS - CONFIG_JOURNAL_SECTORS)
+#define KEYS 20
+
+struct Value
+{
+  uint32_t key;
+  uint32_t generation;
+  uint8_t padding[24];
+};
+
+static bool check(bool condition, const char *what)
+{
+  if (!condition)
+    printf("FAIL: %s\n", what);
+  return condition;
+}
+
+static Value value(uint8_t key, uint32_t generation)
+{
+  Value v;
+  memset(&v, 0, sizeof(v));
+  v.key = key;
+  v.generation = generation;
+  return v;
+}
+
+// every key holds its expected generation, the one in flight may hold either
+static bool holds(ConfigJournal &journal, const uint32_t *expected, int flight = -1, uint32_t next = 0)
+{
+  for (uint8_t key = 0; key < KEYS; key++)
+  {
+    Value v;
+    if (!journal.read(key, &v, sizeof(v)) || v.key != key)
+      return false;
+    if (v.generation != expected[key] && !(key == flight && v.generation == next))
+      return false;
+  }
+  return true;
+}
+
+static uint32_t flashOperations()
+{
+  uint32_t operations = shimFlash.writes;
+  for (int sector = 0; sector < SHIM_FLASH_SECTORS; sector++)
+    operations += shimFlash.erases[sector];
+  return operations;
+}
+
+// the same writes every time, one per key round robin
+static bool step(ConfigJournal &journal, uint32_t *generations, int i)
+{
+  uint8_t key = i % KEYS;
+  Value v = value(key, ++generations[key]);
+  return journal.write(key, &v, sizeof(v)) == journalWritten;
+}
+
+static void mount(ConfigJournal &journal)
+{
+  shimFlash.format();
+  journal.begin(FIRST_SECTOR, CONFIG_JOURNAL_SECTORS);
+}
+
+static bool powerLoss()
+{
+  bool ok = true;
+
+  // find the first write that compacts, and how many flash operations it takes
+  ConfigJournal journal;
+  uint32_t expected[KEYS] = {};
+  mount(journal);
+  int compacting = 0;
+  uint32_t operations;
+  for (;; compacting++)
+  {
+    uint32_t erases = shimFlash.erases[FIRST_SECTOR - SHIM_FLASH_FIRST + 1];
+    operations = flashOperations();
+    step(journal, expected, compacting);
+    operations = flashOperations() - operations;
+    if (shimFlash.erases[FIRST_SECTOR - SHIM_FLASH_FIRST + 1] != erases)
+      break;
+  }
+
+  for (uint32_t cut = 0; cut <= operations; cut++)
+  {
+    ConfigJournal journal;
+    memset(expected, 0, sizeof(expected));
+    mount(journal);
+    for (int i = 0; i < compacting; i++)
+      step(journal, expected, i);
+
+    uint8_t key = compacting % KEYS;
+    shimFlash.cut(cut);
+    bool written = step(journal, expected, compacting);
+    shimFlash.power();
+    uint32_t next = expected[key];
+    if (!written)
+      expected[key]--;
+
+    // the same boot goes on with what it has in RAM
+    ok &= check(holds(journal, expected), "acknowledged values read back after a failed compaction");
+
+    ConfigJournal remounted;
+    ok &= check(remounted.begin(FIRST_SECTOR, CONFIG_JOURNAL_SECTORS), "journal mounts after the power loss");
+    ok &= check(holds(remounted, expected, key, next), "acknowledged values read back after a remount");
+
+    // and keeps working, through the next compactions too
+    for (int i = 0; i < 4 * KEYS * CONFIG_JOURNAL_SECTORS; i++)
+    {
+      if (!step(remounted, expected, i))
+      {
+        ok &= check(false, "writes go on after the power loss");
+        break;
+      }
+    }
+    ok &= check(holds(remounted, expected), "values written after the power loss read back");
+  }
+
+  printf("power cut at each of %u flash operations of a compaction\n", operations + 1);
+  return ok;
+}
+
+static void edit(int session, int i)
+{
+  switch (random(6))
+  {
+  case 0:
+  case 1:
+    Sprinkler.schedule((timeDayOfWeek_t)(dowSunday + random(7)), -1, -1, -1, random(2));
+    break;
+  case 2:
+    Sprinkler.schedule((timeDayOfWeek_t)(dowSunday + random(7)), 5 + random(3), 15 * random(4), -1, -1);
+    break;
+  case 3:
+    Sprinkler.schedule((timeDayOfWeek_t)(dowSunday + random(7)), -1, -1, 10 + 5 * random(4), -1);
+    break;
+  case 4:
+    Sprinkler.setZone(random(3), nullptr, 5 + 5 * random(4));
+    break;
+  default:
+    char name[32];
+    snprintf(name, sizeof(name), "Zone %d.%d", session, i);
+    Sprinkler.setZone(random(3), name, -1);
+    break;
+  }
+}
+
+// a few sessions a week of one to four edits a few seconds apart
+static bool editYear()
+{
+  bool ok = true;
+  shimFlash.format();
+  tmElements_t start = {0, 0, 18, 0, 1, 1, 2021 - 1970};  // 1 Jan 2021 18:00:00
+  setTime(makeTime(start));
+  Sprinkler.setup(Device);
+
+  srand(2021);
+  uint32_t sessions = 0;
+  for (int day = 0; day < 365; day++)
+  {
+    if (random(7) < 3)
+    {
+      sessions++;
+      int edits = 1 + random(4);
+      for (int i = 0; i < edits; i++)
+      {
+        edit(sessions, i);
+        shimAdvance(2000 + random(2000));
+        Device.handle();
+      }
+      shimAdvance(CONFIG_SAVE_DELAY);
+      Device.handle();
+    }
+    shimAdvance(SECS_PER_DAY * 1000UL);
+    Device.handle();
+  }
+
+  uint32_t total = 0, most = 0;
+  for (int sector = 0; sector < SHIM_FLASH_SECTORS; sector++)
+  {
+    total += shimFlash.erases[sector];
+    most = max(most, shimFlash.erases[sector]);
+  }
+
+  // another device reading the same flash sees the same config
+  PrintBuffer<SCHEDULE_WEEK_JSON_SIZE> before, after;
+  Schedule.toJSON(before);
+  PrintBuffer<SPRINKLER_ZONES_JSON_SIZE> zones, reread;
+  Device.zones().toJSON(zones);
+  SprinklerDevice other([] {}, 13, {12, 14, 15});
+  other.load();
+  Schedule.toJSON(after);
+  other.zones().toJSON(reread);
+
+  printf("%u edits in %u sessions: EEPROM %u erases of one sector, journal %u erases over %d sectors, at most %u per sector\n",
+         Device.changes(), sessions, Device.changes(), total, CONFIG_JOURNAL_SECTORS, most);
+  ok &= check(strcmp(before.c_str(), after.c_str()) == 0, "schedule reads back from the journal");
+  ok &= check(strcmp(zones.c_str(), reread.c_str()) == 0, "zones read back from the journal");
+  ok &= check(most * 10 <= Device.changes(), "the journal erases a sector at most once per ten edits");
+  return ok;
+}
+
+// runs after editYear(), on the config it left in the journal
+static bool failedSave()
+{
+  bool ok = true;
+  Sprinkler.setZone(0, "Failed save", -1);
+  shimAdvance(CONFIG_SAVE_DELAY);
+  shimFlash.cut(0);  // the first flash operation of the save is torn
+  Device.handle();
+  shimFlash.power();
+
+  uint32_t writes = shimFlash.writes;
+  shimAdvance(CONFIG_SAVE_DELAY / 2);
+  Device.handle();
+  ok &= check(shimFlash.writes == writes, "a failed save waits another quiet period");
+
+  shimAdvance(CONFIG_SAVE_DELAY / 2);
+  Device.handle();
+  ok &= check(shimFlash.writes != writes, "a failed save is retried");
+
+  SprinklerDevice other([] {}, 13, {12, 14, 15});
+  other.load();
+  ok &= check(strcmp(other.zones()[0].name, "Failed save") == 0, "the retried save reads back");
+
+  writes = shimFlash.writes;
+  shimAdvance(CONFIG_SAVE_DELAY);
+  Device.handle();
+  ok &= check(shimFlash.writes == writes, "a saved config is not written again");
+  return ok;
+}
+
+int main()
+{
+  bool ok = powerLoss();
+  ok &= editYear();
+  ok &= failedSave();
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,161 @@
+// Heap allocations and bytes copied to produce the state and schedule JSON,
+// the String concatenation the firmware used before against the Print
+// writers it uses now. "before" copies the finished String into the
+// response the way AsyncBasicResponse did, "stream" writes into one buffer
+// reserved up front like AsyncResponseStream, "frame" into a PrintBuffer
+// like the WebSocket state frames.
+
+#include <Arduino.h>
+#include <Ticker.h>
+#include <TimeLib.h>
+#include <chrono>
+#include "Heap.h"
+// the old writers read the private state directly
+#define private public
+#define protected public
+#include "sprinkler.h"
+#include "sprinkler-device.h"
+#undef private
+#undef protected
+#include "includes/PrintBuffer.h"
+
+extern SprinklerDevice Device = SprinklerDevice([] {}, 13, {12, 14, 15});
+
+// the writers as they were before, verbatim apart from being free functions
+static String beforeState(SprinklerClass &s)
+{
+  return "{\r\n"
+         "\"zones\":" +
+         (String)(s.startTime ? s.cycleCount() : s.times) + "," +
+         "\"zone\":" +
+         (String)(s.startTime ? (int)s.zone : -1) + "," +
+         "\"timer\":" +
+         (String)(s.remaining()) + "," +
+         " \"on\": " +
+         (String)(s.startTime ? "1" : "0") + "," +
+         "\"started\":" +
+         (String)(s.startTime ? "true" : "false") + "," +
+         "\"paused\":" +
+         (String)(s.pauseTime ? "true" : "false") + "," +
+         "\"time\": \"" +
+         (String)hour() + ":" + (String)minute() + "\"" +
+         "\r\n}";
+}
+
+static String beforeDay(ScheduleClass &d)
+{
+  return "{ \"enabled\": " + (String)d.Enabled + ", \"d\": " + (String)d.Duration + ", \"t\": \"" + (String)hour(d.Time) + ":" + (String)minute(d.Time) + "\" }";
+}
+
+static String beforeWeek(ScheduleWeek &w)
+{
+  return "{\r\n" +
+         ((w.Mon.isEnabled()) ? " \"mon\": " + (String)beforeDay(w.Mon) + ",\r\n" : "") + "" +
+         ((w.Tue.isEnabled()) ? " \"tue\": " + (String)beforeDay(w.Tue) + ",\r\n" : "") + "" +
+         ((w.Wed.isEnabled()) ? " \"wed\": " + (String)beforeDay(w.Wed) + ",\r\n" : "") + "" +
+         ((w.Thu.isEnabled()) ? " \"thu\": " + (String)beforeDay(w.Thu) + ",\r\n" : "") + "" +
+         ((w.Fri.isEnabled()) ? " \"fri\": " + (String)beforeDay(w.Fri) + ",\r\n" : "") + "" +
+         ((w.Sat.isEnabled()) ? " \"sat\": " + (String)beforeDay(w.Sat) + ",\r\n" : "") + "" +
+         ((w.Sun.isEnabled()) ? " \"sun\": " + (String)beforeDay(w.Sun) + ",\r\n" : "") + "" +
+         " \"enabled\": " + (String)w.isEnabled() + ", \"d\": " + (String)w.Duration + ", \"t\": \"" + (String)hour(w.Time) + ":" + (String)minute(w.Time) + "\"" +
+         "\r\n}";
+}
+
+// stands in for the response body, a String either copied or reserved once
+class StringSink : public Print
+{
+public:
+  String body;
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *data, size_t size) override { return body.concat((const char *)data, size) ? size : 0; }
+  using Print::write;
+};
+
+struct Sample
+{
+  uint32_t allocs;
+  uint64_t allocated;
+  uint64_t copied;
+  size_t length;
+  double ns;
+};
+
+template <typename Render>
+static Sample measure(Render render)
+{
+  const int runs = 10000;
+  Sample sample = {};
+  typedef std::chrono::steady_clock clock;
+  clock::time_point begin = clock::now();
+  for (int i = 0; i < runs; i++)
+  {
+    shimHeap.reset();
+    shimStringCopied() = 0;
+    sample.copied = 0;
+    sample.length = render(sample.copied);
+    sample.copied += shimStringCopied();
+    sample.allocs = shimHeap.allocs;
+    sample.allocated = shimHeap.allocated;
+  }
+  sample.ns = std::chrono::duration<double, std::nano>(clock::now() - begin).count() / runs;
+  return sample;
+}
+
+static void report(const char *document, const char *how, const Sample &s)
+{
+  printf("%-8s %-7s %4zu bytes: %3u allocations, %5llu bytes allocated, %5llu bytes copied, %7.0f ns\n",
+         document, how, s.length, s.allocs, (unsigned long long)s.allocated, (unsigned long long)s.copied, s.ns);
+}
+
+int main()
+{
+  tmElements_t start = {0, 30, 7, 2, 5, 4, 2021 - 1970};  // Mon 5 Apr 2021 07:30:00
+  setTime(makeTime(start));
+
+  Sprinkler.setup(Device);
+  for (uint8_t i = 0; i < 3; i++)
+    Sprinkler.setZone(i, "zone", 15);
+  Sprinkler.schedule(7, 0, 15, 1);
+  Sprinkler.schedule(dowSaturday, 6, 45, 20, 1);
+  Sprinkler.schedule(dowSunday, 8, 15, 10, 1);
+  shimAdvance(1000);  // millis() 0 reads as not started
+  Sprinkler.start();
+  shimAdvance(65432);
+
+  report("state", "before", measure([](uint64_t &copied) {
+           String json = beforeState(Sprinkler);
+           String response(json);  // AsyncBasicResponse keeps its own copy
+           return response.length();
+         }));
+  report("state", "stream", measure([](uint64_t &copied) {
+           StringSink sink;
+           sink.body.reserve(SPRINKLER_STATE_JSON_SIZE);
+           Sprinkler.toJSON(sink);
+           return (size_t)sink.body.length();
+         }));
+  report("state", "frame", measure([](uint64_t &copied) {
+           PrintBuffer<SPRINKLER_STATE_JSON_SIZE> frame;
+           Sprinkler.toJSON(frame);
+           copied += frame.length();
+           return frame.length();
+         }));
+
+  report("schedule", "before", measure([](uint64_t &copied) {
+           String json = beforeWeek(Schedule);
+           String response(json);
+           return response.length();
+         }));
+  report("schedule", "stream", measure([](uint64_t &copied) {
+           StringSink sink;
+           sink.body.reserve(SCHEDULE_WEEK_JSON_SIZE);
+           Schedule.toJSON(sink);
+           return (size_t)sink.body.length();
+         }));
+  report("schedule", "frame", measure([](uint64_t &copied) {
+           PrintBuffer<SCHEDULE_WEEK_JSON_SIZE> frame;
+           Schedule.toJSON(frame);
+           copied += frame.length();
+           return frame.length();
+         }));
+  return 0;
+}
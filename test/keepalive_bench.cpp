@@ -0,0 +1,80 @@
+// Requests per second and heap per request of a dashboard polling the
+// state, every request on a new connection closed after the response
+// against kept-alive connections, which the server recycles after
+// ASYNC_KEEPALIVE_MAX_REQUESTS. The host clock stands in for the CPU time,
+// the handshakes and TIME_WAIT pcbs a new connection costs lwIP on the
+// device are not in it and come on top of the "close" numbers.
+
+#include <Arduino.h>
+#include <chrono>
+#include "Heap.h"
+#include <ESPAsyncWebServer.h>
+
+#define ADDRESS 0x6404a8c0  // 192.168.4.100
+#define REQUESTS 10000
+
+static const char persistentRequest[] = "GET /api/state HTTP/1.1\r\nHost: sprinkler\r\nAccept: application/json\r\n\r\n";
+static const char closingRequest[] = "GET /api/state HTTP/1.1\r\nHost: sprinkler\r\nAccept: application/json\r\nConnection: close\r\n\r\n";
+
+struct Sample
+{
+  uint32_t connections;
+  double allocs;
+  double allocated;
+  size_t peak;
+  double ns;
+};
+
+static Sample run(bool persistent)
+{
+  Sample sample = {};
+  ShimPeer *peer = nullptr;
+  size_t base = shimHeap.live;
+  shimHeap.reset();
+
+  typedef std::chrono::steady_clock clock;
+  clock::time_point begin = clock::now();
+  for (int i = 0; i < REQUESTS; i++)
+  {
+    if (!peer || !peer->open())
+    {
+      delete peer;
+      peer = ShimPeer::connect(80, ADDRESS);
+      sample.connections++;
+    }
+    peer->send(persistent ? persistentRequest : closingRequest);
+    peer->ack();
+    // the browser closes when the response says so
+    if (strstr(peer->received(), "Connection: close"))
+      peer->disconnect();
+    peer->drop();
+  }
+  delete peer;
+  sample.ns = std::chrono::duration<double, std::nano>(clock::now() - begin).count() / REQUESTS;
+
+  sample.allocs = (double)shimHeap.allocs / REQUESTS;
+  sample.allocated = (double)shimHeap.allocated / REQUESTS;
+  sample.peak = shimHeap.peak - base;
+  return sample;
+}
+
+static void report(const char *how, const Sample &s)
+{
+  // a handshake costs the browser a round trip before the request goes out
+  printf("%-10s %5u connections: %4.2f round trips, %7.0f requests/s, %4.1f allocations, %4.0f bytes allocated per request, peak %4zu bytes\n",
+         how, s.connections, 1.0 + (double)s.connections / REQUESTS, 1e9 / s.ns, s.allocs, s.allocated, s.peak);
+}
+
+int main()
+{
+  AsyncWebServer server(80);
+  server.on("/api/state", HTTP_GET, [](AsyncWebServerRequest *request) {
+    request->send(200, "application/json", "{\"zones\":3,\"zone\":-1,\"timer\":0,\"on\":0,\"paused\":false}");
+  });
+  server.begin();
+
+  run(true);  // warm up
+  report("close", run(false));
+  report("keep-alive", run(true));
+  return 0;
+}
@@ -0,0 +1,74 @@
+// Size and encode time of the WebSocket state frames, JSON against the
+// MessagePack a client may switch to, written into the PrintBuffer the
+// frames are serialized into. "stopped" and "running" are the whole state a
+// client gets when it subscribes, "timer" the delta of a duration change,
+// only the fields changed since the client's version. Each frame also has a
+// 2 byte WebSocket header.
+
+#include <Arduino.h>
+#include <Ticker.h>
+#include <TimeLib.h>
+#include <chrono>
+#include "Heap.h"
+#include "sprinkler.h"
+#include "sprinkler-device.h"
+#include "includes/PrintBuffer.h"
+
+extern SprinklerDevice Device = SprinklerDevice([] {}, 13, {12, 14, 15});
+
+struct Sample
+{
+  size_t length;
+  uint32_t allocs;
+  double ns;
+};
+
+template <size_t N>
+static Sample measure(bool msgpack, uint32_t since)
+{
+  const int runs = 1000000;
+  Sample sample = {};
+  shimHeap.reset();
+  typedef std::chrono::steady_clock clock;
+  clock::time_point begin = clock::now();
+  for (int i = 0; i < runs; i++)
+  {
+    PrintBuffer<N> frame;
+    if (msgpack)
+      Sprinkler.toMsgPack(frame, since);
+    else
+      Sprinkler.toJSON(frame, since);
+    sample.length = frame.length();
+  }
+  sample.ns = std::chrono::duration<double, std::nano>(clock::now() - begin).count() / runs;
+  sample.allocs = shimHeap.allocs;
+  return sample;
+}
+
+static void report(const char *frame, uint32_t since)
+{
+  Sample json = measure<SPRINKLER_STATE_JSON_SIZE>(false, since);
+  Sample msgpack = measure<SPRINKLER_STATE_MSGPACK_SIZE>(true, since);
+  printf("%-8s JSON %3zu bytes %4.0f ns, MessagePack %2zu bytes %4.0f ns, %u allocations\n",
+         frame, json.length, json.ns, msgpack.length, msgpack.ns, json.allocs + msgpack.allocs);
+}
+
+int main()
+{
+  tmElements_t start = {0, 30, 7, 2, 5, 4, 2021 - 1970};  // Mon 5 Apr 2021 07:30:00
+  setTime(makeTime(start));
+
+  Sprinkler.setup(Device);
+  for (uint8_t i = 0; i < 3; i++)
+    Sprinkler.setZone(i, "zone", 15);
+  report("stopped", 0);
+
+  shimAdvance(1000);  // millis() 0 reads as not started
+  Sprinkler.start();
+  shimAdvance(65432);
+  report("running", 0);
+
+  Sprinkler.setDuration(Sprinkler.getDuration());  // changes the timer only
+  report("timer", Sprinkler.getVersion() - 1);
+  return 0;
+}
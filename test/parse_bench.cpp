@@ -0,0 +1,151 @@
+// Time and heap per request from its first byte to the handler's response,
+// what a browser sends to the firmware's routes on a kept-alive connection.
+// Built once against the library and once against test/webserver/before, the
+// parser before it parsed request lines in place (PARSER names which). The
+// response is the same on both sides and included, the heap numbers are the
+// whole request: its object, its headers, the parse and the response.
+
+#include <Arduino.h>
+#include <chrono>
+#include <string>
+#include "Heap.h"
+#include <ESPAsyncWebServer.h>
+#include <ArduinoJson.h>
+#include <AsyncJson.h>
+#include "includes/AsyncRouteHandler.h"
+
+#define ADDRESS 0x6404a8c0  // 192.168.4.100
+#define REQUESTS 10000
+
+struct Target
+{
+  void respond(AsyncWebServerRequest *request) { request->send(204); }
+};
+
+typedef AsyncRouteHandler<Target> Router;
+
+static const Router::Route routes[] = {
+  {HTTP_GET, "/",          &Target::respond, nullptr},
+  {HTTP_GET, "/api/state", &Target::respond, nullptr},
+};
+
+#define BROWSER                                                                                                    \
+  "Host: 192.168.4.1\r\n"                                                                                          \
+  "Connection: keep-alive\r\n"                                                                                     \
+  "User-Agent: Mozilla/5.0 (Linux; Android 10; K) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0.0.0 Mobile Safari/537.36\r\n" \
+  "Accept-Encoding: gzip, deflate\r\n"                                                                             \
+  "Accept-Language: en-US,en;q=0.9\r\n"
+
+// the dashboard polling the state
+static const char poll[] =
+  "GET /api/state HTTP/1.1\r\n" BROWSER
+  "Accept: */*\r\n"
+  "Referer: http://192.168.4.1/\r\n"
+  "\r\n";
+
+// the page revalidated
+static const char page[] =
+  "GET / HTTP/1.1\r\n" BROWSER
+  "Cache-Control: max-age=0\r\n"
+  "Upgrade-Insecure-Requests: 1\r\n"
+  "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+  "If-None-Match: \"5f3df03a\"\r\n"
+  "\r\n";
+
+// the settings form saved
+static const char settings[] =
+  "POST /api/settings HTTP/1.1\r\n" BROWSER
+  "Content-Length: 73\r\n"
+  "Content-Type: application/json\r\n"
+  "Accept: */*\r\n"
+  "Origin: http://192.168.4.1\r\n"
+  "Referer: http://192.168.4.1/\r\n"
+  "\r\n"
+  "{\"zones\":[{\"name\":\"Front lawn\",\"enabled\":1},{\"name\":\"Beds\",\"enabled\":1}]}";
+
+struct Sample
+{
+  double allocs;
+  double allocated;
+  size_t peak;
+  double ns;
+  uint32_t responses;
+};
+
+static uint32_t answered(ShimPeer *peer)
+{
+  uint32_t n = 0;
+  for (const char *at = peer->received(); (at = strstr(at, "HTTP/1.1 ")); at++)
+    n++;
+  return n;
+}
+
+// count requests in one segment each, two per segment when pipelined
+static Sample run(const char *request, int count)
+{
+  std::string segment;
+  for (int i = 0; i < count; i++)
+    segment += request;
+
+  Sample sample = {};
+  ShimPeer *peer = nullptr;
+  size_t base = shimHeap.live;
+  shimHeap.reset();
+
+  typedef std::chrono::steady_clock clock;
+  clock::time_point begin = clock::now();
+  for (int i = 0; i < REQUESTS; i += count)
+  {
+    // the server closes a connection after ASYNC_KEEPALIVE_MAX_REQUESTS
+    if (!peer || !peer->open())
+    {
+      delete peer;
+      peer = ShimPeer::connect(80, ADDRESS);
+    }
+    peer->send(segment.c_str());
+    for (int j = 0; j < count; j++)
+      peer->ack();
+    sample.responses += answered(peer);
+    if (strstr(peer->received(), "Connection: close"))
+      peer->disconnect();
+    peer->drop();
+  }
+  delete peer;
+  sample.ns = std::chrono::duration<double, std::nano>(clock::now() - begin).count() / REQUESTS;
+
+  sample.allocs = (double)shimHeap.allocs / REQUESTS;
+  sample.allocated = (double)shimHeap.allocated / REQUESTS;
+  sample.peak = shimHeap.peak - base;
+  return sample;
+}
+
+static void report(const char *what, const char *request, int count)
+{
+  Sample s = run(request, count);
+  printf("%-9s %-10s %3zu bytes: %6.0f ns, %4.1f allocations, %5.0f bytes allocated per request, peak %5zu bytes%s\n",
+         PARSER, what, strlen(request), s.ns, s.allocs, s.allocated, s.peak,
+         s.responses == REQUESTS ? "" : ", requests lost");
+}
+
+static Target target;
+
+static void json(AsyncWebServerRequest *request, JsonVariant &json)
+{
+  (void)json;
+  request->send(204);
+}
+
+int main()
+{
+  AsyncWebServer server(80);
+  server.addHandler(new Router(&target, routes));
+  server.addHandler(new AsyncCallbackJsonWebHandler("/api/settings", json));
+  server.begin();
+
+  run(poll, 1);  // warm up
+  report("poll", poll, 1);
+  report("page", page, 1);
+  report("settings", settings, 1);
+  report("pipelined", poll, 2);
+  return 0;
+}
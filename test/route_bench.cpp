@@ -0,0 +1,138 @@
+// Time and heap allocations to pick the handler of a request, the chain of
+// server.on() handlers the firmware registered before against the sorted
+// route table it registers now. Both servers end with the JSON body
+// handlers; the update, upgrade and asset handlers come after them in the
+// firmware and are the same on both sides, they are left out.
+
+#include <Arduino.h>
+#include <chrono>
+#include "Heap.h"
+// the request url and method are set directly
+#define private public
+#define protected public
+#include <ESPAsyncWebServer.h>
+#undef private
+#undef protected
+#include <ArduinoJson.h>
+#include <AsyncJson.h>
+#include "includes/AsyncRouteHandler.h"
+
+struct Target
+{
+  void respond(AsyncWebServerRequest *request) { (void)request; }
+  void respondDay(AsyncWebServerRequest *request, const char *day) { (void)request, (void)day; }
+};
+
+typedef AsyncRouteHandler<Target> Router;
+
+static const Router::Route routes[] = {
+  {HTTP_GET, "/",                     &Target::respond,   nullptr},
+  {HTTP_GET, "/api/clients",          &Target::respond,   nullptr},
+  {HTTP_GET, "/api/off",              &Target::respond,   nullptr},
+  {HTTP_GET, "/api/on",               &Target::respond,   nullptr},
+  {HTTP_GET, "/api/pause",            &Target::respond,   nullptr},
+  {HTTP_GET, "/api/resume",           &Target::respond,   nullptr},
+  {HTTP_GET, "/api/schedule",         &Target::respond,   nullptr},
+  {HTTP_GET, "/api/schedule/",        nullptr,            &Target::respondDay},
+  {HTTP_GET, "/api/settings",         &Target::respond,   nullptr},
+  {HTTP_GET, "/api/snapshot",         &Target::respond,   nullptr},
+  {HTTP_GET, "/api/start",            &Target::respond,   nullptr},
+  {HTTP_GET, "/api/state",            &Target::respond,   nullptr},
+  {HTTP_GET, "/api/stats",            &Target::respond,   nullptr},
+  {HTTP_GET, "/api/stop",             &Target::respond,   nullptr},
+  {HTTP_GET, "/api/zone",             &Target::respond,   nullptr},
+  {HTTP_GET, "/api/zones",            &Target::respond,   nullptr},
+  {HTTP_GET, "/index.html",           &Target::respond,   nullptr},
+  {HTTP_GET, "/manifest.json",        &Target::respond,   nullptr},
+  {HTTP_GET, "/reset",                &Target::respond,   nullptr},
+  {HTTP_GET, "/restart",              &Target::respond,   nullptr},
+};
+
+// the registration order of the firmware before the route table
+static const char *const chain[] = {
+  "/", "/favicon.png", "/apple-touch-icon.png", "/manifest.json", "/reset", "/restart",
+  "/api/settings", "/api/on", "/api/off", "/api/state", "/api/start", "/api/stop",
+  "/api/pause", "/api/resume", "/api/zones", "/api/zone",
+  "/api/schedule/mon", "/api/schedule/tue", "/api/schedule/wed", "/api/schedule/thu",
+  "/api/schedule/fri", "/api/schedule/sat", "/api/schedule/sun", "/api/schedule",
+};
+
+// what a dashboard asks for, a polled state first, and a miss
+static const char *const urls[] = {
+  "/api/state", "/", "/api/zones", "/api/schedule", "/api/schedule/sun", "/restart", "/missing",
+};
+
+static void json(AsyncWebServerRequest *request, JsonVariant &json)
+{
+  (void)request, (void)json;
+}
+
+static void before(AsyncWebServer &server)
+{
+  for (const char *path : chain)
+  {
+    server.on(path, HTTP_GET, [](AsyncWebServerRequest *request) { (void)request; });
+    if (!strcmp(path, "/api/settings"))
+      server.addHandler(new AsyncCallbackJsonWebHandler("/api/settings", json));
+  }
+  server.addHandler(new AsyncCallbackJsonWebHandler("/api/schedule", json));
+}
+
+static Target target;
+
+static void after(AsyncWebServer &server)
+{
+  server.addHandler(new Router(&target, routes));
+  server.addHandler(new AsyncCallbackJsonWebHandler("/api/settings", json));
+  server.addHandler(new AsyncCallbackJsonWebHandler("/api/schedule", json));
+}
+
+struct Sample
+{
+  double allocs;
+  double ns;
+  bool found;
+};
+
+static Sample measure(AsyncWebServer &server, const char *url)
+{
+  const int runs = 100000;
+  AsyncClient client;
+  AsyncWebServerRequest request(&server, &client);
+  request._url = url;
+  request._method = HTTP_GET;
+  server._attachHandler(&request);  // the interesting headers are added once
+
+  typedef std::chrono::steady_clock clock;
+  shimHeap.reset();
+  clock::time_point begin = clock::now();
+  for (int i = 0; i < runs; i++)
+    server._attachHandler(&request);
+  Sample sample;
+  sample.ns = std::chrono::duration<double, std::nano>(clock::now() - begin).count() / runs;
+  sample.allocs = (double)shimHeap.allocs / runs;
+  sample.found = request._handler != server._catchAllHandler;
+  return sample;
+}
+
+int main()
+{
+  AsyncWebServer chained(80), routed(81);
+  before(chained);
+  after(routed);
+
+  printf("%zu handlers before, %zu routes in one handler now\n", sizeof(chain) / sizeof(chain[0]) + 2, sizeof(routes) / sizeof(routes[0]));
+  double total[2] = {};
+  for (const char *url : urls)
+  {
+    Sample a = measure(chained, url);
+    Sample b = measure(routed, url);
+    total[0] += a.ns;
+    total[1] += b.ns;
+    printf("%-18s before %6.0f ns %5.1f allocations, now %4.0f ns %3.1f allocations%s\n",
+           url, a.ns, a.allocs, b.ns, b.allocs, b.found ? "" : ", not found");
+  }
+  size_t n = sizeof(urls) / sizeof(urls[0]);
+  printf("%-18s before %6.0f ns, now %4.0f ns\n", "mean", total[0] / n, total[1] / n);
+  return 0;
+}
@@ -0,0 +1,13 @@
+#!/bin/sh
+# Builds the schedule simulator and plays a trace, year.trace by default. The
+# valve transitions go to build/<trace>.valves, compare them with the ones
+# kept next to the trace to see what a change to the engine did.
+#
+#   ./run.sh [trace]
+
+set -e
+trace=${1:+$(realpath "$1")}
+cd "$(dirname "$0")"
+trace=${trace:-year.trace}
+make --no-print-directory build/simulator
+./build/simulator "$trace" "build/$(basename "$trace" .trace).valves"
@@ -0,0 +1,230 @@
+#ifndef Arduino_h
+#define Arduino_h
+
+// Just enough of the ESP8266 Arduino core to build the firmware headers and
+// the vendored libraries on the host. millis() runs on a virtual clock the
+// harnesses move with shimAdvance(), which also fires due Tickers.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+#include "WString.h"
+
+#ifndef ARDUINO
+#define ARDUINO 10800
+#endif
+#ifndef ESP8266
+#define ESP8266
+#endif
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x00
+#define INPUT_PULLUP 0x02
+#define OUTPUT 0x01
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+#define LED_BUILTIN 2
+
+#define PROGMEM
+#define ICACHE_RAM_ATTR
+#define ICACHE_FLASH_ATTR
+#define ICACHE_RODATA_ATTR
+#define IRAM_ATTR
+#define PGM_P const char *
+#define PSTR(s) (s)
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define pgm_read_dword(p) (*(const uint32_t *)(p))
+#define pgm_read_ptr(p) (*(const void *const *)(p))
+#define memcpy_P memcpy
+#define memcmp_P memcmp
+#define strlen_P strlen
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define strcasecmp_P strcasecmp
+#define strstr_P strstr
+#define sprintf_P sprintf
+#define snprintf_P snprintf
+#define vsnprintf_P vsnprintf
+#define os_printf printf
+#define ets_printf ::printf  // not the printf() member of the class calling it
+#define os_strlen strlen
+#define RANDOM_REG32 ((uint32_t)rand())
+
+#define digitalPinToInterrupt(p) (p)
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+using std::max;
+using std::min;
+
+// size_t is unsigned int on the ESP8266, the libraries mix the two in std::min
+namespace std
+{
+inline unsigned long min(unsigned long a, unsigned int b) { return a < b ? a : b; }
+}
+
+// virtual clock, 32 bits wide like unsigned long on the ESP8266 so it wraps
+// after 49.7 days there too; firmware that keeps it in an unsigned long is
+// only exact on the host away from the wrap
+uint32_t millis();
+uint32_t micros();
+void delay(unsigned long ms);
+void yield();
+void shimAdvance(unsigned long ms);  // move the clock, firing due Tickers on the way
+
+// pins keep their last written level so a harness can watch the valves
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+typedef void (*PinWatcher)(uint8_t pin, uint8_t value);
+void shimWatchPins(PinWatcher watcher);
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode);
+void attachInterruptArg(uint8_t pin, void (*handler)(void *), void *arg, int mode);
+void detachInterrupt(uint8_t pin);
+void shimInterrupt(uint8_t pin, uint8_t value);  // drive an input and run its interrupt handler
+
+long random(long max);
+long random(long min, long max);
+
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size)
+  {
+    size_t n = 0;
+    while (size--)
+    {
+      if (!write(*buffer++))
+        break;
+      n++;
+    }
+    return n;
+  }
+  size_t write(const char *s) { return s ? write((const uint8_t *)s, strlen(s)) : 0; }
+  size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+  virtual void flush() {}
+
+  size_t print(const __FlashStringHelper *s) { return write((const char *)s); }
+  size_t print(const String &s) { return write((const uint8_t *)s.c_str(), s.length()); }
+  size_t print(const char *s) { return write(s); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(unsigned char n, int base = DEC) { return printNumber(n, base); }
+  size_t print(int n, int base = DEC) { return print((long)n, base); }
+  size_t print(unsigned int n, int base = DEC) { return printNumber(n, base); }
+  size_t print(long n, int base = DEC)
+  {
+    if (base == DEC && n < 0)
+      return print('-') + printNumber(-(unsigned long)n, base);
+    return printNumber(n, base);
+  }
+  size_t print(unsigned long n, int base = DEC) { return printNumber(n, base); }
+  size_t print(double n, int digits = 2)
+  {
+    char buffer[40];
+    snprintf(buffer, sizeof(buffer), "%.*f", digits, n);
+    return write(buffer);
+  }
+
+  template <typename T>
+  size_t println(const T &value) { return print(value) + println(); }
+  template <typename T>
+  size_t println(const T &value, int format) { return print(value, format) + println(); }
+  size_t println() { return write("\r\n"); }
+
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)))
+  {
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    return write((const uint8_t *)buffer, n < (int)sizeof(buffer) ? n : sizeof(buffer) - 1);
+  }
+  size_t printf_P(const char *format, ...) __attribute__((format(printf, 2, 3)))
+  {
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    return write((const uint8_t *)buffer, n < (int)sizeof(buffer) ? n : sizeof(buffer) - 1);
+  }
+
+private:
+  size_t printNumber(unsigned long n, int base)
+  {
+    char buffer[8 * sizeof(long) + 1];
+    char *p = &buffer[sizeof(buffer) - 1];
+    *p = 0;
+    if (base < 2)
+      base = 10;
+    do
+    {
+      char digit = n % base;
+      n /= base;
+      *--p = digit < 10 ? digit + '0' : digit + 'A' - 10;
+    } while (n);
+    return write(p);
+  }
+};
+
+class Stream : public Print
+{
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  virtual size_t readBytes(char *buffer, size_t length)
+  {
+    size_t n = 0;
+    int c;
+    while (n < length && (c = read()) >= 0)
+      buffer[n++] = c;
+    return n;
+  }
+  size_t readBytes(uint8_t *buffer, size_t length) { return readBytes((char *)buffer, length); }
+  void setTimeout(unsigned long) {}
+};
+
+// logs go nowhere unless a harness sets echo
+class HardwareSerial : public Stream
+{
+public:
+  bool echo = false;
+  void begin(unsigned long) {}
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buffer, size_t size) override
+  {
+    if (echo)
+      fwrite(buffer, 1, size, stdout);
+    return size;
+  }
+  using Print::write;
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  void setDebugOutput(bool) {}
+};
+
+extern HardwareSerial Serial;
+
+#include "Esp.h"
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef EEPROM_h
+#define EEPROM_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// RAM backed, survives a simulated reboot as long as the object does
+class EEPROMClass
+{
+public:
+  void begin(size_t size)
+  {
+    this->size = size <= sizeof(data) ? size : sizeof(data);
+  }
+
+  uint8_t read(int address) { return address < (int)size ? data[address] : 0; }
+  void write(int address, uint8_t value)
+  {
+    if (address < (int)size)
+      data[address] = value;
+  }
+
+  template <typename T>
+  T &get(int address, T &value)
+  {
+    if (address + sizeof(T) <= size)
+      memcpy(&value, data + address, sizeof(T));
+    return value;
+  }
+
+  template <typename T>
+  const T &put(int address, const T &value)
+  {
+    if (address + sizeof(T) <= size)
+      memcpy(data + address, &value, sizeof(T));
+    return value;
+  }
+
+  bool commit()
+  {
+    commits++;
+    return true;
+  }
+
+  bool end() { return commit(); }
+  size_t length() { return size; }
+
+  uint32_t commits = 0;
+
+private:
+  uint8_t data[4096] = {};
+  size_t size = 0;
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef ESP8266WiFi_h
+#define ESP8266WiFi_h
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+typedef enum
+{
+  WL_IDLE_STATUS = 0,
+  WL_CONNECTED = 3,
+  WL_DISCONNECTED = 6
+} wl_status_t;
+
+class ESP8266WiFiClass
+{
+public:
+  wl_status_t status() { return WL_CONNECTED; }
+  bool disconnect(bool wifioff = false) { return true; }
+  String hostname() { return "sprinkler"; }
+  bool hostname(const String &) { return true; }
+  IPAddress localIP() { return IPAddress(192, 168, 4, 1); }
+  IPAddress softAPIP() { return IPAddress(192, 168, 4, 1); }
+};
+
+extern ESP8266WiFiClass WiFi;
+
+#endif
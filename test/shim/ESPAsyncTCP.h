@@ -0,0 +1,191 @@
+#ifndef ASYNCTCP_H_
+#define ASYNCTCP_H_
+
+// ESPAsyncTCP without lwIP: every connection is a loopback pair, the server
+// side an AsyncClient with the library's API and callback order, the far
+// side a ShimPeer the harness drives. Nothing happens on its own, the peer
+// delivers data, acknowledges what was sent and ticks the poll timer, each
+// synchronously. The send buffer is TCP_SND_BUF of the core's lwIP build,
+// lwIP's own segment copies are not counted on the heap.
+
+#include <Arduino.h>
+#include <IPAddress.h>
+#include <functional>
+
+#define ASYNC_MAX_ACK_TIME 5000
+#define ASYNC_WRITE_FLAG_COPY 0x01
+#define ASYNC_WRITE_FLAG_MORE 0x02
+
+#define SHIM_TCP_MSS 1460
+#define SHIM_TCP_SND_BUF (2 * SHIM_TCP_MSS)
+
+typedef int8_t err_t;
+#define ERR_OK 0
+#define ERR_ABRT -13
+
+class AsyncClient;
+class AsyncServer;
+class ShimPeer;
+
+typedef std::function<void(void *, AsyncClient *)> AcConnectHandler;
+typedef std::function<void(void *, AsyncClient *, size_t len, uint32_t time)> AcAckHandler;
+typedef std::function<void(void *, AsyncClient *, err_t error)> AcErrorHandler;
+typedef std::function<void(void *, AsyncClient *, void *data, size_t len)> AcDataHandler;
+typedef std::function<void(void *, AsyncClient *, uint32_t time)> AcTimeoutHandler;
+
+class AsyncClient
+{
+  friend class ShimPeer;
+
+private:
+  ShimPeer *_peer;  // nullptr once the connection is gone
+  bool _closing;    // close() waits for the next poll, like the library's _close_pcb
+  uint32_t _rxTimeout;
+  uint32_t _rxLast;
+  size_t _unsent;   // added, not sent yet
+  size_t _unacked;  // sent, not acknowledged yet
+  uint32_t _sentAt;
+
+  AcConnectHandler _discard_cb;
+  void *_discard_cb_arg;
+  AcAckHandler _sent_cb;
+  void *_sent_cb_arg;
+  AcErrorHandler _error_cb;
+  void *_error_cb_arg;
+  AcDataHandler _recv_cb;
+  void *_recv_cb_arg;
+  AcTimeoutHandler _timeout_cb;
+  void *_timeout_cb_arg;
+  AcConnectHandler _poll_cb;
+  void *_poll_cb_arg;
+
+  void _close();
+
+public:
+  AsyncClient();
+  ~AsyncClient();
+
+  void close(bool now = false);
+  void stop() { close(false); }
+  void abort();
+  bool free() { return !_peer; }
+
+  bool canSend() { return !_unacked && space() > 0; }
+  size_t space() { return _peer ? SHIM_TCP_SND_BUF - _unsent - _unacked : 0; }
+  size_t add(const char *data, size_t size, uint8_t apiflags = 0);
+  bool send();
+  size_t ack(size_t len) { return len; }
+  void ackLater() {}
+
+  size_t write(const char *data) { return data ? write(data, strlen(data)) : 0; }
+  size_t write(const char *data, size_t size, uint8_t apiflags = 0);
+
+  uint8_t state() { return _peer ? 4 : 0; }
+  bool connecting() { return false; }
+  bool connected() { return _peer && !_closing; }
+  bool disconnecting() { return _peer && _closing; }
+  bool disconnected() { return !_peer; }
+  bool freeable() { return !connected(); }
+
+  uint16_t getMss() { return SHIM_TCP_MSS; }
+  uint32_t getRxTimeout() { return _rxTimeout; }
+  void setRxTimeout(uint32_t timeout) { _rxTimeout = timeout; }
+  uint32_t getAckTimeout() { return ASYNC_MAX_ACK_TIME; }
+  void setAckTimeout(uint32_t timeout) { (void)timeout; }
+  void setNoDelay(bool nodelay) { (void)nodelay; }
+  bool getNoDelay() { return true; }
+  uint32_t getRemoteAddress();
+  uint16_t getRemotePort();
+  uint32_t getLocalAddress() { return IPAddress(192, 168, 4, 1); }
+  uint16_t getLocalPort() { return 80; }
+
+  IPAddress remoteIP() { return IPAddress(getRemoteAddress()); }
+  uint16_t remotePort() { return getRemotePort(); }
+  IPAddress localIP() { return IPAddress(getLocalAddress()); }
+  uint16_t localPort() { return getLocalPort(); }
+
+  void onDisconnect(AcConnectHandler cb, void *arg = 0) { _discard_cb = cb, _discard_cb_arg = arg; }
+  void onAck(AcAckHandler cb, void *arg = 0) { _sent_cb = cb, _sent_cb_arg = arg; }
+  void onError(AcErrorHandler cb, void *arg = 0) { _error_cb = cb, _error_cb_arg = arg; }
+  void onData(AcDataHandler cb, void *arg = 0) { _recv_cb = cb, _recv_cb_arg = arg; }
+  void onTimeout(AcTimeoutHandler cb, void *arg = 0) { _timeout_cb = cb, _timeout_cb_arg = arg; }
+  void onPoll(AcConnectHandler cb, void *arg = 0) { _poll_cb = cb, _poll_cb_arg = arg; }
+
+  const char *errorToString(err_t error) { return error == ERR_ABRT ? "Connection aborted" : "OK"; }
+  const char *stateToString() { return _peer ? "Established" : "Closed"; }
+};
+
+class AsyncServer
+{
+  friend class ShimPeer;
+
+private:
+  uint16_t _port;
+  AcConnectHandler _connect_cb;
+  void *_connect_cb_arg;
+  AsyncServer *_next;  // listening servers
+
+public:
+  AsyncServer(uint16_t port);
+  ~AsyncServer();
+  void onClient(AcConnectHandler cb, void *arg) { _connect_cb = cb, _connect_cb_arg = arg; }
+  void begin();
+  void end();
+  void setNoDelay(bool nodelay) { (void)nodelay; }
+  bool getNoDelay() { return true; }
+  uint8_t status();
+};
+
+// The browser end of a connection. It outlives the server's AsyncClient, so
+// a harness keeps calling it after the server deleted its side; every call
+// is a no-op on a closed connection. Its memory is the browser's, it stays
+// off the counted heap.
+class ShimPeer
+{
+  friend class AsyncClient;
+
+private:
+  AsyncClient *client;
+  uint32_t address;
+  uint16_t port;
+  char *buffer;  // what the server sent, NUL terminated
+  size_t length;
+  size_t capacity;
+
+  void receive(const char *data, size_t size);
+
+public:
+  size_t total;  // bytes received, also counting what drop() discarded
+  bool closed;   // the server closed or aborted the connection
+
+  // connects to the server listening on port, nullptr when none is
+  static ShimPeer *connect(uint16_t port, uint32_t address);
+
+  ShimPeer(uint32_t address, uint16_t port);
+  ~ShimPeer();
+  void *operator new(size_t size);
+  void operator delete(void *ptr);
+
+  bool open() const { return client; }
+  AsyncClient *server() const { return client; }
+  const char *received() const { return buffer ? buffer : ""; }
+  size_t receivedLength() const { return length; }
+
+  // delivers data to the server in segments of at most one MSS
+  void send(const char *data, size_t len);
+  void send(const char *text) { send(text, strlen(text)); }
+  // acknowledges everything the server sent so far, returns the bytes
+  size_t ack();
+  // one tick of the library's poll timer, rx and ack timeouts included
+  void poll();
+  // the browser closes its end
+  void disconnect();
+  // forgets what was received, to keep long runs small
+  void drop()
+  {
+    if (buffer)
+      buffer[length = 0] = 0;
+  }
+};
+
+#endif
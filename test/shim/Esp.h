@@ -0,0 +1,28 @@
+#ifndef Esp_h
+#define Esp_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "WString.h"
+
+class EspClass
+{
+public:
+  bool restarted = false;  // set by restart()/reset(), a harness decides what a reboot means
+
+  uint32_t getChipId() { return 0x00c0ffee; }
+  uint32_t getFreeHeap();
+  uint32_t getFreeSketchSpace() { return 1 << 20; }
+  String getResetReason() { return "External System"; }
+  void restart() { restarted = true; }
+  void reset() { restarted = true; }
+
+  // emulated NOR flash, see flash_hal.h for the region it covers
+  bool flashEraseSector(uint32_t sector);
+  bool flashWrite(uint32_t offset, uint32_t *data, size_t size);
+  bool flashRead(uint32_t offset, uint32_t *data, size_t size);
+};
+
+extern EspClass ESP;
+
+#endif
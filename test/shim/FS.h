@@ -0,0 +1,47 @@
+#ifndef FS_H
+#define FS_H
+
+#include <Arduino.h>
+
+// No file system on the host: every open fails, the handlers that serve
+// files answer as they do when the file is missing.
+namespace fs
+{
+
+class File : public Stream
+{
+public:
+  operator bool() const { return false; }
+  size_t write(uint8_t c) override { (void)c; return 0; }
+  size_t write(const uint8_t *buffer, size_t size) override { (void)buffer; (void)size; return 0; }
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  size_t read(uint8_t *buffer, size_t size) { (void)buffer; (void)size; return 0; }
+  bool seek(uint32_t position) { (void)position; return false; }
+  size_t position() const { return 0; }
+  size_t size() const { return 0; }
+  void close() {}
+  const char *name() const { return ""; }
+  const char *fullName() const { return ""; }
+  bool isFile() const { return false; }
+  bool isDirectory() const { return false; }
+};
+
+class FS
+{
+public:
+  File open(const char *path, const char *mode) { (void)path; (void)mode; return File(); }
+  File open(const String &path, const char *mode) { return open(path.c_str(), mode); }
+  bool exists(const char *path) { (void)path; return false; }
+  bool exists(const String &path) { return exists(path.c_str()); }
+  bool remove(const char *path) { (void)path; return false; }
+  bool remove(const String &path) { return remove(path.c_str()); }
+};
+
+}  // namespace fs
+
+using fs::File;
+using fs::FS;
+
+#endif
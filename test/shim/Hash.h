@@ -0,0 +1,11 @@
+#ifndef HASH_H_
+#define HASH_H_
+
+#include <Arduino.h>
+
+// SHA-1 as the core provides it, for the WebSocket handshake
+void sha1(const uint8_t *data, uint32_t size, uint8_t hash[20]);
+void sha1(const char *data, uint32_t size, uint8_t hash[20]);
+void sha1(const String &data, uint8_t hash[20]);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef Heap_h
+#define Heap_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Allocation counters, live only when heap.cpp (the malloc/new hooks) is
+// linked in. ESP.getFreeHeap() reports SHIM_HEAP_SIZE minus the live bytes.
+#define SHIM_HEAP_SIZE 40000
+
+struct ShimHeap
+{
+  uint32_t allocs;     // malloc, calloc, realloc to a new block and operator new
+  uint32_t frees;
+  uint64_t allocated;  // bytes requested, summed
+  size_t live;         // bytes currently held
+  size_t peak;         // highest live since the last reset
+
+  void reset()
+  {
+    allocs = frees = 0;
+    allocated = 0;
+    peak = live;
+  }
+};
+
+extern ShimHeap shimHeap;
+
+#endif
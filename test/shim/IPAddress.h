@@ -0,0 +1,30 @@
+#ifndef IPAddress_h
+#define IPAddress_h
+
+#include <Arduino.h>
+
+// an IPv4 address, stored in network order like the core's
+class IPAddress
+{
+private:
+  uint32_t address;
+
+public:
+  IPAddress() : address(0) {}
+  IPAddress(uint32_t address) : address(address) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : address(a | b << 8 | c << 16 | (uint32_t)d << 24) {}
+
+  operator uint32_t() const { return address; }
+  uint8_t operator[](int index) const { return address >> (8 * index); }
+  bool operator==(const IPAddress &other) const { return address == other.address; }
+  bool operator!=(const IPAddress &other) const { return address != other.address; }
+
+  String toString() const
+  {
+    char text[16];
+    snprintf(text, sizeof(text), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+    return String(text);
+  }
+};
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef Sprinkler_shim_h
+#define Sprinkler_shim_h
+
+// The firmware includes "Sprinkler.h" for sprinkler.h, which only resolves on
+// the case-insensitive file systems it is built on.
+#include "sprinkler.h"
+
+#endif
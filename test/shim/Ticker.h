@@ -0,0 +1,55 @@
+#ifndef Ticker_h
+#define Ticker_h
+
+#include <functional>
+#include <stdint.h>
+
+// Tickers fire from shimAdvance() in due order, on the virtual clock. The
+// scheduled variants behave the same here since there is no interrupt
+// context to leave.
+class Ticker
+{
+public:
+  typedef std::function<void(void)> callback_function_t;
+
+  Ticker() {}
+  ~Ticker() { detach(); }
+
+  void attach(float seconds, callback_function_t callback) { start(seconds * 1000, true, callback); }
+  void attach_ms(uint32_t ms, callback_function_t callback) { start(ms, true, callback); }
+  void attach_scheduled(float seconds, callback_function_t callback) { attach(seconds, callback); }
+  void attach_ms_scheduled(uint32_t ms, callback_function_t callback) { attach_ms(ms, callback); }
+  void once(float seconds, callback_function_t callback) { start(seconds * 1000, false, callback); }
+  void once_ms(uint32_t ms, callback_function_t callback) { start(ms, false, callback); }
+  void once_scheduled(float seconds, callback_function_t callback) { once(seconds, callback); }
+  void once_ms_scheduled(uint32_t ms, callback_function_t callback) { once_ms(ms, callback); }
+
+  template <typename TArg>
+  void attach(float seconds, void (*callback)(TArg), TArg arg) { attach(seconds, [=] { callback(arg); }); }
+  template <typename TArg>
+  void attach_ms(uint32_t ms, void (*callback)(TArg), TArg arg) { attach_ms(ms, [=] { callback(arg); }); }
+  template <typename TArg>
+  void once(float seconds, void (*callback)(TArg), TArg arg) { once(seconds, [=] { callback(arg); }); }
+  template <typename TArg>
+  void once_ms(uint32_t ms, void (*callback)(TArg), TArg arg) { once_ms(ms, [=] { callback(arg); }); }
+
+  void detach();
+  bool active() const { return armed; }
+
+  // earliest due time of any armed ticker, false if none is armed
+  static bool next(uint32_t &due);
+  // fire every ticker due at or before now
+  static void fire(uint32_t now);
+
+private:
+  void start(uint32_t ms, bool repeat, callback_function_t callback);
+
+  callback_function_t callback;
+  uint32_t due = 0;
+  uint32_t period = 0;
+  bool repeat = false;
+  bool armed = false;
+  Ticker *nextTicker = nullptr;
+};
+
+#endif
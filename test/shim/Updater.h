@@ -0,0 +1,14 @@
+#ifndef Updater_h
+#define Updater_h
+
+#include <Arduino.h>
+
+class UpdaterClass
+{
+public:
+  bool isRunning() { return false; }
+};
+
+extern UpdaterClass Update;
+
+#endif
@@ -0,0 +1,420 @@
+#ifndef WString_h
+#define WString_h
+
+// Host stand-in for the ESP8266 core String: same 11 byte small string
+// buffer and the same exact-size realloc growth, so allocation counts taken
+// on the host match what the firmware does on the device.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <strings.h>
+#include <stdarg.h>
+
+class __FlashStringHelper;
+#define F(s) ((const __FlashStringHelper *)(s))
+#define FPSTR(p) ((const __FlashStringHelper *)(p))
+
+class StringSumHelper;
+
+// bytes String has moved around: copies, appends and reallocs that moved
+inline uint64_t &shimStringCopied()
+{
+  static uint64_t bytes;
+  return bytes;
+}
+
+class String
+{
+private:
+  enum { SSOSIZE = 12 };
+  char *ptr;
+  unsigned int cap;
+  unsigned int len;
+  char sso[SSOSIZE];
+
+  bool isSSO() const { return ptr == sso; }
+
+  bool changeBuffer(unsigned int size)
+  {
+    if (size < SSOSIZE)
+    {
+      if (!isSSO())
+      {
+        memcpy(sso, ptr, len + 1 < SSOSIZE ? len + 1 : SSOSIZE);
+        sso[SSOSIZE - 1] = 0;
+        ::free(ptr);
+        ptr = sso;
+      }
+      cap = SSOSIZE - 1;
+      return true;
+    }
+    char *buffer = (char *)::realloc(isSSO() ? nullptr : ptr, size + 1);
+    if (!buffer)
+      return false;
+    if (isSSO())
+      memcpy(buffer, sso, len + 1);
+    if (buffer != ptr)
+      shimStringCopied() += len;
+    ptr = buffer;
+    cap = size;
+    return true;
+  }
+
+  String &copy(const char *value, unsigned int length)
+  {
+    if (!reserve(length))
+    {
+      invalidate();
+      return *this;
+    }
+    len = length;
+    memmove(ptr, value, length);
+    ptr[length] = 0;
+    shimStringCopied() += length;
+    return *this;
+  }
+
+  void number(const char *format, ...) __attribute__((format(printf, 2, 3)))
+  {
+    char buffer[34];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    copy(buffer, strlen(buffer));
+  }
+
+  void radix(unsigned long value, int base, bool negative)
+  {
+    char buffer[34];
+    char *p = buffer + sizeof(buffer) - 1;
+    *p = 0;
+    do
+    {
+      unsigned digit = value % base;
+      *--p = digit < 10 ? '0' + digit : 'a' + digit - 10;
+      value /= base;
+    } while (value);
+    if (negative)
+      *--p = '-';
+    copy(p, strlen(p));
+  }
+
+  void init()
+  {
+    ptr = sso;
+    cap = SSOSIZE - 1;
+    len = 0;
+    sso[0] = 0;
+  }
+
+  void invalidate()
+  {
+    if (!isSSO())
+      ::free(ptr);
+    init();
+  }
+
+public:
+  String() { init(); }
+  String(const char *value)
+  {
+    init();
+    if (value)
+      copy(value, strlen(value));
+  }
+  String(const __FlashStringHelper *value) : String((const char *)value) {}
+  String(const String &value)
+  {
+    init();
+    copy(value.ptr, value.len);
+  }
+  String(String &&value)
+  {
+    init();
+    *this = static_cast<String &&>(value);
+  }
+  explicit String(char c)
+  {
+    init();
+    copy(&c, 1);
+  }
+  explicit String(unsigned char value, unsigned char base = 10) { init(); radix(value, base, false); }
+  explicit String(int value, unsigned char base = 10)
+  {
+    init();
+    if (base == 10)
+      number("%d", value);
+    else
+      radix((unsigned int)value, base, false);
+  }
+  explicit String(unsigned int value, unsigned char base = 10) { init(); radix(value, base, false); }
+  explicit String(long value, unsigned char base = 10)
+  {
+    init();
+    if (base == 10)
+      number("%ld", value);
+    else
+      radix((unsigned long)value, base, false);
+  }
+  explicit String(unsigned long value, unsigned char base = 10) { init(); radix(value, base, false); }
+  explicit String(float value, unsigned char decimals = 2) { init(); number("%.*f", decimals, value); }
+  explicit String(double value, unsigned char decimals = 2) { init(); number("%.*f", decimals, value); }
+  ~String() { invalidate(); }
+
+  String &operator=(const String &rhs) { return this == &rhs ? *this : copy(rhs.ptr, rhs.len); }
+  String &operator=(const char *value) { return value ? copy(value, strlen(value)) : (invalidate(), *this); }
+  String &operator=(const __FlashStringHelper *value) { return *this = (const char *)value; }
+  String &operator=(String &&rhs)
+  {
+    if (this == &rhs)
+      return *this;
+    if (rhs.isSSO())
+      return copy(rhs.ptr, rhs.len);
+    invalidate();
+    ptr = rhs.ptr;
+    cap = rhs.cap;
+    len = rhs.len;
+    rhs.init();
+    return *this;
+  }
+
+  bool reserve(unsigned int size)
+  {
+    if (size <= cap)
+      return true;
+    return changeBuffer(size);
+  }
+
+  unsigned int length() const { return len; }
+  bool isEmpty() const { return len == 0; }
+  const char *c_str() const { return ptr; }
+  char *begin() { return ptr; }
+  char *end() { return ptr + len; }
+  const char *begin() const { return ptr; }
+  const char *end() const { return ptr + len; }
+
+  bool concat(const char *value, unsigned int length)
+  {
+    if (!value)
+      return false;
+    if (!length)
+      return true;
+    if (!reserve(len + length))
+      return false;
+    memmove(ptr + len, value, length);
+    shimStringCopied() += length;
+    len += length;
+    ptr[len] = 0;
+    return true;
+  }
+  bool concat(const String &value) { return concat(value.ptr, value.len); }
+  bool concat(const char *value) { return value && concat(value, strlen(value)); }
+  bool concat(const __FlashStringHelper *value) { return concat((const char *)value); }
+  bool concat(char c) { return concat(&c, 1); }
+  bool concat(unsigned char value) { return concat(String(value)); }
+  bool concat(int value) { return concat(String(value)); }
+  bool concat(unsigned int value) { return concat(String(value)); }
+  bool concat(long value) { return concat(String(value)); }
+  bool concat(unsigned long value) { return concat(String(value)); }
+  bool concat(float value) { return concat(String(value)); }
+  bool concat(double value) { return concat(String(value)); }
+
+  template <typename T>
+  String &operator+=(const T &value)
+  {
+    concat(value);
+    return *this;
+  }
+
+  explicit operator bool() const { return true; }
+
+  int compareTo(const String &s) const { return strcmp(ptr, s.ptr); }
+  bool equals(const String &s) const { return len == s.len && compareTo(s) == 0; }
+  bool equals(const char *s) const { return s ? strcmp(ptr, s) == 0 : len == 0; }
+  bool equalsIgnoreCase(const String &s) const { return len == s.len && strcasecmp(ptr, s.ptr) == 0; }
+  bool equalsConstantTime(const String &s) const { return equals(s); }
+  bool operator==(const String &rhs) const { return equals(rhs); }
+  bool operator==(const char *rhs) const { return equals(rhs); }
+  bool operator!=(const String &rhs) const { return !equals(rhs); }
+  bool operator!=(const char *rhs) const { return !equals(rhs); }
+  bool operator<(const String &rhs) const { return compareTo(rhs) < 0; }
+  bool startsWith(const String &prefix, unsigned int offset = 0) const
+  {
+    return offset + prefix.len <= len && strncmp(ptr + offset, prefix.ptr, prefix.len) == 0;
+  }
+  bool endsWith(const String &suffix) const
+  {
+    return suffix.len <= len && strcmp(ptr + len - suffix.len, suffix.ptr) == 0;
+  }
+
+  char charAt(unsigned int index) const { return index < len ? ptr[index] : 0; }
+  void setCharAt(unsigned int index, char c)
+  {
+    if (index < len)
+      ptr[index] = c;
+  }
+  char operator[](unsigned int index) const { return charAt(index); }
+  char &operator[](unsigned int index) { return ptr[index]; }
+  void getBytes(unsigned char *buf, unsigned int size, unsigned int index = 0) const
+  {
+    if (!size || !buf)
+      return;
+    unsigned int n = index < len ? len - index : 0;
+    if (n > size - 1)
+      n = size - 1;
+    memcpy(buf, ptr + index, n);
+    buf[n] = 0;
+  }
+  void toCharArray(char *buf, unsigned int size, unsigned int index = 0) const { getBytes((unsigned char *)buf, size, index); }
+
+  int indexOf(char c, unsigned int from = 0) const
+  {
+    if (from >= len)
+      return -1;
+    const char *p = strchr(ptr + from, c);
+    return p ? p - ptr : -1;
+  }
+  int indexOf(const char *s, unsigned int from = 0) const
+  {
+    if (from > len)
+      return -1;
+    const char *p = strstr(ptr + from, s);
+    return p ? p - ptr : -1;
+  }
+  int indexOf(const String &s, unsigned int from = 0) const { return indexOf(s.ptr, from); }
+  int lastIndexOf(char c) const
+  {
+    const char *p = strrchr(ptr, c);
+    return p ? p - ptr : -1;
+  }
+  int lastIndexOf(const String &s) const
+  {
+    int found = -1;
+    for (int i = indexOf(s); i >= 0; i = indexOf(s, i + 1))
+      found = i;
+    return found;
+  }
+
+  String substring(unsigned int from) const { return substring(from, len); }
+  String substring(unsigned int from, unsigned int to) const
+  {
+    if (from > to)
+    {
+      unsigned int t = from;
+      from = to;
+      to = t;
+    }
+    String out;
+    if (from >= len)
+      return out;
+    if (to > len)
+      to = len;
+    out.copy(ptr + from, to - from);
+    return out;
+  }
+
+  void replace(char find, char replace)
+  {
+    for (char *p = ptr; *p; p++)
+      if (*p == find)
+        *p = replace;
+  }
+  void replace(const String &find, const String &replace)
+  {
+    if (!find.len)
+      return;
+    String out;
+    int from = 0;
+    for (int i = indexOf(find); i >= 0; i = indexOf(find, from))
+    {
+      out.concat(ptr + from, i - from);
+      out.concat(replace);
+      from = i + find.len;
+    }
+    out.concat(ptr + from, len - from);
+    *this = static_cast<String &&>(out);
+  }
+  void remove(unsigned int index) { remove(index, (unsigned int)-1); }
+  void remove(unsigned int index, unsigned int count)
+  {
+    if (index >= len)
+      return;
+    if (count > len - index)
+      count = len - index;
+    memmove(ptr + index, ptr + index + count, len - index - count);
+    len -= count;
+    ptr[len] = 0;
+  }
+  void toLowerCase()
+  {
+    for (char *p = ptr; *p; p++)
+      *p = tolower(*p);
+  }
+  void toUpperCase()
+  {
+    for (char *p = ptr; *p; p++)
+      *p = toupper(*p);
+  }
+  void trim()
+  {
+    unsigned int begin = 0;
+    while (begin < len && isspace((unsigned char)ptr[begin]))
+      begin++;
+    unsigned int end = len;
+    while (end > begin && isspace((unsigned char)ptr[end - 1]))
+      end--;
+    len = end - begin;
+    memmove(ptr, ptr + begin, len);
+    ptr[len] = 0;
+  }
+
+  long toInt() const { return atol(ptr); }
+  float toFloat() const { return atof(ptr); }
+  double toDouble() const { return atof(ptr); }
+
+  friend StringSumHelper &operator+(const StringSumHelper &lhs, const String &rhs);
+  friend StringSumHelper &operator+(const StringSumHelper &lhs, const char *rhs);
+  friend StringSumHelper &operator+(const StringSumHelper &lhs, char c);
+};
+
+class StringSumHelper : public String
+{
+public:
+  StringSumHelper(const String &s) : String(s) {}
+  StringSumHelper(const char *p) : String(p) {}
+  StringSumHelper(char c) : String(c) {}
+  StringSumHelper(int num) : String(num) {}
+  StringSumHelper(unsigned int num) : String(num) {}
+  StringSumHelper(long num) : String(num) {}
+  StringSumHelper(unsigned long num) : String(num) {}
+};
+
+inline StringSumHelper &operator+(const StringSumHelper &lhs, const String &rhs)
+{
+  StringSumHelper &a = const_cast<StringSumHelper &>(lhs);
+  a.concat(rhs);
+  return a;
+}
+inline StringSumHelper &operator+(const StringSumHelper &lhs, const char *rhs)
+{
+  StringSumHelper &a = const_cast<StringSumHelper &>(lhs);
+  a.concat(rhs);
+  return a;
+}
+inline StringSumHelper &operator+(const StringSumHelper &lhs, char c)
+{
+  StringSumHelper &a = const_cast<StringSumHelper &>(lhs);
+  a.concat(c);
+  return a;
+}
+inline StringSumHelper &operator+(const StringSumHelper &lhs, int value) { return lhs + String(value); }
+inline StringSumHelper &operator+(const StringSumHelper &lhs, unsigned int value) { return lhs + String(value); }
+inline StringSumHelper &operator+(const StringSumHelper &lhs, long value) { return lhs + String(value); }
+inline StringSumHelper &operator+(const StringSumHelper &lhs, unsigned long value) { return lhs + String(value); }
+inline StringSumHelper &operator+(const StringSumHelper &lhs, const __FlashStringHelper *rhs) { return lhs + (const char *)rhs; }
+
+#endif
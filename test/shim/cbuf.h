@@ -0,0 +1,114 @@
+#ifndef __cbuf_h
+#define __cbuf_h
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the core's ring buffer, as AsyncResponseStream uses it
+class cbuf
+{
+private:
+  size_t _size;
+  char *_buf;
+  const char *_bufend;
+  char *_begin;
+  char *_end;
+
+  char *wrap(char *ptr) const { return ptr == _bufend ? _buf : ptr; }
+
+public:
+  cbuf(size_t size) : _size(size), _buf((char *)malloc(size)), _bufend(_buf + size), _begin(_buf), _end(_buf) {}
+  ~cbuf() { free(_buf); }
+
+  size_t available() const
+  {
+    return _end >= _begin ? _end - _begin : _size - (_begin - _end);
+  }
+  size_t size() const { return _size; }
+  size_t room() const
+  {
+    return _end >= _begin ? _size - (_end - _begin) - 1 : _begin - _end - 1;
+  }
+  bool empty() const { return _begin == _end; }
+  bool full() const { return wrap(_end + 1) == _begin; }
+
+  bool resize(size_t newSize)
+  {
+    size_t bytes = available();
+    if (newSize < bytes)
+      return false;
+    char *buf = (char *)malloc(newSize);
+    if (!buf)
+      return false;
+    peek(buf, bytes);
+    free(_buf);
+    _buf = buf;
+    _size = newSize;
+    _bufend = _buf + _size;
+    _begin = _buf;
+    _end = _buf + bytes;
+    return true;
+  }
+  size_t resizeAdd(size_t addSize) { return resize(_size + addSize) ? _size : 0; }
+
+  int peek() { return empty() ? -1 : (unsigned char)*_begin; }
+  size_t peek(char *dst, size_t size)
+  {
+    size_t n = size < available() ? size : available();
+    char *from = _begin;
+    for (size_t i = 0; i < n; i++)
+    {
+      dst[i] = *from;
+      from = wrap(from + 1);
+    }
+    return n;
+  }
+
+  int read()
+  {
+    if (empty())
+      return -1;
+    char c = *_begin;
+    _begin = wrap(_begin + 1);
+    return (unsigned char)c;
+  }
+  size_t read(char *dst, size_t size)
+  {
+    size_t n = peek(dst, size);
+    remove(n);
+    return n;
+  }
+  size_t remove(size_t size)
+  {
+    size_t n = size < available() ? size : available();
+    for (size_t i = 0; i < n; i++)
+      _begin = wrap(_begin + 1);
+    return n;
+  }
+
+  size_t write(char c)
+  {
+    if (full())
+      return 0;
+    *_end = c;
+    _end = wrap(_end + 1);
+    return 1;
+  }
+  size_t write(const char *src, size_t size)
+  {
+    size_t n = size < room() ? size : room();
+    for (size_t i = 0; i < n; i++)
+    {
+      *_end = src[i];
+      _end = wrap(_end + 1);
+    }
+    return n;
+  }
+
+  void flush() { _begin = _end = _buf; }
+
+  cbuf *next;
+};
+
+#endif
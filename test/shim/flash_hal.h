@@ -0,0 +1,57 @@
+#ifndef flash_hal_h
+#define flash_hal_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// A small window of emulated flash stands in for the FS region. Writes can
+// only clear bits, like NOR flash, and every erase is counted per sector.
+#define FLASH_SECTOR_SIZE 0x1000
+#define SHIM_FLASH_FIRST 0x300  // sector number of the window, 3 MB in
+#define SHIM_FLASH_SECTORS 16
+
+#define FS_PHYS_ADDR ((uint32_t)SHIM_FLASH_FIRST * FLASH_SECTOR_SIZE)
+#define FS_PHYS_SIZE ((uint32_t)SHIM_FLASH_SECTORS * FLASH_SECTOR_SIZE)
+#define FS_PHYS_PAGE 0x100
+#define FS_PHYS_BLOCK 0x2000
+
+struct ShimFlash
+{
+  uint8_t data[SHIM_FLASH_SECTORS][FLASH_SECTOR_SIZE];
+  uint32_t erases[SHIM_FLASH_SECTORS];
+  uint32_t writes;
+  // power loss: once this many more erase/write calls went through, the next
+  // one is torn (a write stores only its first half) and everything after
+  // fails until power() is called; -1 never cuts the power
+  long budget = -1;
+  bool down = false;
+
+  ShimFlash()
+  {
+    format();
+  }
+
+  void cut(long operations)
+  {
+    budget = operations;
+  }
+
+  void power()
+  {
+    budget = -1;
+    down = false;
+  }
+
+  void format()
+  {
+    memset(data, 0xff, sizeof(data));
+    memset(erases, 0, sizeof(erases));
+    writes = 0;
+    power();
+  }
+};
+
+extern ShimFlash shimFlash;
+
+#endif
@@ -0,0 +1,78 @@
+// Counts every heap allocation the harness makes. glibc's own entry points do
+// the work, these only keep score.
+#include <malloc.h>
+#include <new>
+#include "Heap.h"
+
+extern "C" void *__libc_malloc(size_t);
+extern "C" void *__libc_calloc(size_t, size_t);
+extern "C" void *__libc_realloc(void *, size_t);
+extern "C" void __libc_free(void *);
+
+static void *counted(void *ptr, size_t size)
+{
+  if (ptr)
+  {
+    shimHeap.allocs++;
+    shimHeap.allocated += size;
+    shimHeap.live += malloc_usable_size(ptr);
+    if (shimHeap.live > shimHeap.peak)
+      shimHeap.peak = shimHeap.live;
+  }
+  return ptr;
+}
+
+extern "C" void *malloc(size_t size)
+{
+  return counted(__libc_malloc(size), size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+  return counted(__libc_calloc(count, size), count * size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+  if (!ptr)
+    return malloc(size);
+  size_t before = malloc_usable_size(ptr);
+  void *grown = __libc_realloc(ptr, size);
+  if (grown)
+  {
+    shimHeap.live += malloc_usable_size(grown) - before;
+    if (shimHeap.live > shimHeap.peak)
+      shimHeap.peak = shimHeap.live;
+    if (grown != ptr)
+    {
+      shimHeap.allocs++;
+      shimHeap.frees++;
+    }
+    shimHeap.allocated += size;
+  }
+  return grown;
+}
+
+extern "C" void free(void *ptr)
+{
+  if (!ptr)
+    return;
+  shimHeap.frees++;
+  shimHeap.live -= malloc_usable_size(ptr);
+  __libc_free(ptr);
+}
+
+void *operator new(size_t size)
+{
+  void *ptr = malloc(size);
+  if (!ptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+void *operator new[](size_t size) { return operator new(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return malloc(size); }
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { return malloc(size); }
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete[](void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { free(ptr); }
@@ -0,0 +1,25 @@
+#ifndef __ESP8266_MD5__
+#define __ESP8266_MD5__
+
+#include <stdint.h>
+
+// The core's MD5 entry points for digest authentication. No harness enables
+// authentication, the digest is left zeroed.
+
+typedef struct
+{
+  uint32_t state[4];
+  uint32_t count[2];
+  uint8_t buffer[64];
+} md5_context_t;
+
+inline void MD5Init(md5_context_t *context) { *context = md5_context_t(); }
+inline void MD5Update(md5_context_t *context, const uint8_t *data, uint16_t len) { (void)context; (void)data; (void)len; }
+inline void MD5Final(uint8_t hash[16], md5_context_t *context)
+{
+  (void)context;
+  for (int i = 0; i < 16; i++)
+    hash[i] = 0;
+}
+
+#endif
@@ -0,0 +1,220 @@
+#include <Arduino.h>
+#include <Ticker.h>
+#include <EEPROM.h>
+#include <ESP8266WiFi.h>
+#include <Updater.h>
+#include <flash_hal.h>
+#include "Heap.h"
+
+HardwareSerial Serial;
+EspClass ESP;
+ShimHeap shimHeap;
+
+static uint32_t clockMs;
+static Ticker *tickers;
+
+uint32_t EspClass::getFreeHeap()
+{
+  return shimHeap.live < SHIM_HEAP_SIZE ? SHIM_HEAP_SIZE - shimHeap.live : 0;
+}
+
+uint32_t millis() { return clockMs; }
+uint32_t micros() { return clockMs * 1000; }
+void yield() {}
+void delay(unsigned long ms) { shimAdvance(ms); }
+
+void shimAdvance(unsigned long ms)
+{
+  // in steps short enough to compare across the wrap
+  while (ms)
+  {
+    uint32_t step = ms < 0x40000000UL ? ms : 0x40000000UL;
+    uint32_t target = clockMs + step;
+    uint32_t due;
+    while (Ticker::next(due) && (int32_t)(due - target) <= 0)
+    {
+      if ((int32_t)(due - clockMs) > 0)
+        clockMs = due;
+      Ticker::fire(clockMs);
+    }
+    clockMs = target;
+    ms -= step;
+  }
+}
+
+void Ticker::start(uint32_t ms, bool repeat, callback_function_t callback)
+{
+  detach();
+  this->callback = callback;
+  this->period = ms;
+  this->repeat = repeat;
+  this->due = clockMs + ms;
+  this->armed = true;
+  nextTicker = tickers;
+  tickers = this;
+}
+
+void Ticker::detach()
+{
+  if (!armed)
+    return;
+  armed = false;
+  for (Ticker **link = &tickers; *link; link = &(*link)->nextTicker)
+  {
+    if (*link == this)
+    {
+      *link = nextTicker;
+      break;
+    }
+  }
+  nextTicker = nullptr;
+}
+
+bool Ticker::next(uint32_t &due)
+{
+  bool found = false;
+  for (Ticker *t = tickers; t; t = t->nextTicker)
+  {
+    if (!found || (int32_t)(t->due - due) < 0)
+      due = t->due;
+    found = true;
+  }
+  return found;
+}
+
+void Ticker::fire(uint32_t now)
+{
+  for (Ticker *t = tickers; t; t = t->nextTicker)
+  {
+    if ((int32_t)(t->due - now) > 0)
+      continue;
+    callback_function_t callback = t->callback;
+    if (t->repeat)
+      t->due += t->period ? t->period : 1;
+    else
+      t->detach();
+    callback();
+    return;  // the list may have changed under the callback, the caller asks again
+  }
+}
+
+static uint8_t pinLevel[32];
+static PinWatcher pinWatcher;
+static void (*pinHandler[32])(void *);
+static void *pinArg[32];
+
+void pinMode(uint8_t, uint8_t) {}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+  if (pin >= 32)
+    return;
+  bool changed = pinLevel[pin] != value;
+  pinLevel[pin] = value;
+  if (changed && pinWatcher)
+    pinWatcher(pin, value);
+}
+
+int digitalRead(uint8_t pin) { return pin < 32 ? pinLevel[pin] : LOW; }
+
+void shimWatchPins(PinWatcher watcher) { pinWatcher = watcher; }
+
+static void callPlain(void *handler) { ((void (*)(void))handler)(); }
+
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode)
+{
+  attachInterruptArg(pin, callPlain, (void *)handler, mode);
+}
+
+void attachInterruptArg(uint8_t pin, void (*handler)(void *), void *arg, int)
+{
+  if (pin >= 32)
+    return;
+  pinHandler[pin] = handler;
+  pinArg[pin] = arg;
+}
+
+void detachInterrupt(uint8_t pin)
+{
+  if (pin < 32)
+    pinHandler[pin] = nullptr;
+}
+
+void shimInterrupt(uint8_t pin, uint8_t value)
+{
+  if (pin >= 32)
+    return;
+  pinLevel[pin] = value;
+  if (pinHandler[pin])
+    pinHandler[pin](pinArg[pin]);
+}
+
+long random(long max) { return max > 0 ? rand() % max : 0; }
+long random(long min, long max) { return min + random(max - min); }
+
+EEPROMClass EEPROM;
+UpdaterClass Update;
+ESP8266WiFiClass WiFi;
+ShimFlash shimFlash;
+
+static bool flashSector(uint32_t sector, uint32_t &index)
+{
+  index = sector - SHIM_FLASH_FIRST;
+  return sector >= SHIM_FLASH_FIRST && index < SHIM_FLASH_SECTORS;
+}
+
+// counts down the power budget, false once the power is gone
+static bool flashPowered(bool &torn)
+{
+  torn = false;
+  if (shimFlash.down)
+    return false;
+  if (shimFlash.budget == 0)
+  {
+    shimFlash.down = true;
+    torn = true;
+  }
+  else if (shimFlash.budget > 0)
+  {
+    shimFlash.budget--;
+  }
+  return true;
+}
+
+bool EspClass::flashEraseSector(uint32_t sector)
+{
+  uint32_t index;
+  bool torn;
+  if (!flashSector(sector, index) || !flashPowered(torn))
+    return false;
+  // a torn erase leaves the first half erased
+  memset(shimFlash.data[index], 0xff, torn ? FLASH_SECTOR_SIZE / 2 : FLASH_SECTOR_SIZE);
+  shimFlash.erases[index]++;
+  return !torn;
+}
+
+bool EspClass::flashWrite(uint32_t offset, uint32_t *data, size_t size)
+{
+  uint32_t index;
+  bool torn;
+  uint32_t position = offset % FLASH_SECTOR_SIZE;
+  if (offset % 4 || size % 4 || position + size > FLASH_SECTOR_SIZE ||
+      !flashSector(offset / FLASH_SECTOR_SIZE, index) || !flashPowered(torn))
+    return false;
+  size_t written = torn ? size / 2 : size;
+  const uint8_t *bytes = (const uint8_t *)data;
+  for (size_t i = 0; i < written; i++)
+    shimFlash.data[index][position + i] &= bytes[i];
+  shimFlash.writes++;
+  return !torn;
+}
+
+bool EspClass::flashRead(uint32_t offset, uint32_t *data, size_t size)
+{
+  uint32_t index;
+  uint32_t position = offset % FLASH_SECTOR_SIZE;
+  if (offset % 4 || position + size > FLASH_SECTOR_SIZE || !flashSector(offset / FLASH_SECTOR_SIZE, index))
+    return false;
+  memcpy(data, shimFlash.data[index] + position, size);
+  return true;
+}
@@ -0,0 +1,252 @@
+// The loopback connections behind ESPAsyncTCP.h. The callback order and the
+// close and abort semantics follow ESPAsyncTCP.cpp: close() waits for the
+// next poll, close(true) and abort() call onDisconnect right away, and the
+// rx timeout closes from the poll without calling onTimeout.
+#include <ESPAsyncTCP.h>
+
+extern "C" void *__libc_malloc(size_t);
+extern "C" void *__libc_realloc(void *, size_t);
+extern "C" void __libc_free(void *);
+
+static AsyncServer *listening;
+
+AsyncClient::AsyncClient()
+    : _peer(nullptr), _closing(false), _rxTimeout(0), _rxLast(millis()), _unsent(0), _unacked(0), _sentAt(0),
+      _discard_cb_arg(nullptr), _sent_cb_arg(nullptr), _error_cb_arg(nullptr), _recv_cb_arg(nullptr),
+      _timeout_cb_arg(nullptr), _poll_cb_arg(nullptr)
+{
+}
+
+AsyncClient::~AsyncClient()
+{
+  if (_peer)
+    _close();
+}
+
+void AsyncClient::_close()
+{
+  if (!_peer)
+    return;
+  _peer->client = nullptr;
+  _peer->closed = true;
+  _peer = nullptr;
+  if (_discard_cb)
+    _discard_cb(_discard_cb_arg, this);
+}
+
+void AsyncClient::close(bool now)
+{
+  if (now)
+    _close();
+  else
+    _closing = true;
+}
+
+void AsyncClient::abort()
+{
+  if (!_peer)
+    return;
+  _peer->client = nullptr;
+  _peer->closed = true;
+  _peer = nullptr;
+  // tcp_abort() reports through the error callback, which discards the client
+  if (_error_cb)
+    _error_cb(_error_cb_arg, this, ERR_ABRT);
+  if (_discard_cb)
+    _discard_cb(_discard_cb_arg, this);
+}
+
+size_t AsyncClient::add(const char *data, size_t size, uint8_t apiflags)
+{
+  (void)apiflags;
+  if (!_peer || !data || !size)
+    return 0;
+  size_t room = space();
+  if (!room)
+    return 0;
+  size_t n = size < room ? size : room;
+  _peer->receive(data, n);
+  _unsent += n;
+  return n;
+}
+
+bool AsyncClient::send()
+{
+  if (!_peer)
+    return false;
+  _unacked += _unsent;
+  _unsent = 0;
+  _sentAt = millis();
+  return true;
+}
+
+size_t AsyncClient::write(const char *data, size_t size, uint8_t apiflags)
+{
+  size_t n = add(data, size, apiflags);
+  if (!n || !send())
+    return 0;
+  return n;
+}
+
+uint32_t AsyncClient::getRemoteAddress()
+{
+  return _peer ? _peer->address : 0;
+}
+
+uint16_t AsyncClient::getRemotePort()
+{
+  return _peer ? _peer->port : 0;
+}
+
+AsyncServer::AsyncServer(uint16_t port) : _port(port), _connect_cb_arg(nullptr), _next(nullptr)
+{
+}
+
+AsyncServer::~AsyncServer()
+{
+  end();
+}
+
+void AsyncServer::begin()
+{
+  end();
+  _next = listening;
+  listening = this;
+}
+
+void AsyncServer::end()
+{
+  for (AsyncServer **link = &listening; *link; link = &(*link)->_next)
+  {
+    if (*link == this)
+    {
+      *link = _next;
+      break;
+    }
+  }
+  _next = nullptr;
+}
+
+uint8_t AsyncServer::status()
+{
+  for (AsyncServer *s = listening; s; s = s->_next)
+  {
+    if (s == this)
+      return 1;
+  }
+  return 0;
+}
+
+ShimPeer *ShimPeer::connect(uint16_t port, uint32_t address)
+{
+  static uint16_t ports = 49152;
+  for (AsyncServer *s = listening; s; s = s->_next)
+  {
+    if (s->_port != port || !s->_connect_cb)
+      continue;
+    ShimPeer *peer = new ShimPeer(address, ports++);
+    AsyncClient *client = new AsyncClient();
+    client->_peer = peer;
+    peer->client = client;
+    s->_connect_cb(s->_connect_cb_arg, client);
+    return peer;
+  }
+  return nullptr;
+}
+
+ShimPeer::ShimPeer(uint32_t address, uint16_t port)
+    : client(nullptr), address(address), port(port), buffer(nullptr), length(0), capacity(0), total(0), closed(false)
+{
+}
+
+ShimPeer::~ShimPeer()
+{
+  disconnect();
+  __libc_free(buffer);
+}
+
+void *ShimPeer::operator new(size_t size)
+{
+  return __libc_malloc(size);
+}
+
+void ShimPeer::operator delete(void *ptr)
+{
+  __libc_free(ptr);
+}
+
+void ShimPeer::receive(const char *data, size_t size)
+{
+  if (length + size + 1 > capacity)
+  {
+    capacity = (length + size + 1) * 2;
+    buffer = (char *)__libc_realloc(buffer, capacity);
+  }
+  memcpy(buffer + length, data, size);
+  length += size;
+  buffer[length] = 0;
+  total += size;
+}
+
+void ShimPeer::send(const char *data, size_t len)
+{
+  // a pbuf the stack hands over, written in place by the parsers
+  char *segment = (char *)__libc_malloc(SHIM_TCP_MSS + 1);
+  while (client && len)
+  {
+    size_t n = len < SHIM_TCP_MSS ? len : SHIM_TCP_MSS;
+    memcpy(segment, data, n);
+    segment[n] = 0;
+    client->_rxLast = millis();
+    if (client->_recv_cb)
+      client->_recv_cb(client->_recv_cb_arg, client, segment, n);
+    data += n;
+    len -= n;
+  }
+  __libc_free(segment);
+}
+
+size_t ShimPeer::ack()
+{
+  if (!client || !client->_unacked)
+    return 0;
+  size_t len = client->_unacked;
+  client->_unacked = 0;
+  client->_rxLast = millis();
+  if (client->_sent_cb)
+    client->_sent_cb(client->_sent_cb_arg, client, len, millis() - client->_sentAt);
+  return len;
+}
+
+void ShimPeer::poll()
+{
+  if (!client)
+    return;
+  if (client->_closing)
+  {
+    client->_closing = false;
+    client->_close();
+    return;
+  }
+
+  uint32_t now = millis();
+  if (client->_unacked && now - client->_sentAt >= ASYNC_MAX_ACK_TIME)
+  {
+    if (client->_timeout_cb)
+      client->_timeout_cb(client->_timeout_cb_arg, client, now - client->_sentAt);
+    return;
+  }
+  if (client->_rxTimeout && now - client->_rxLast >= client->_rxTimeout * 1000)
+  {
+    client->_close();
+    return;
+  }
+  if (client->_poll_cb)
+    client->_poll_cb(client->_poll_cb_arg, client);
+}
+
+void ShimPeer::disconnect()
+{
+  if (client)
+    client->_close();
+}
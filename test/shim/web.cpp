@@ -0,0 +1,167 @@
+// SHA-1 and base64, what the WebSocket handshake needs from the core.
+#include <Hash.h>
+#include <libb64/cencode.h>
+
+static uint32_t rotate(uint32_t value, int bits)
+{
+  return value << bits | value >> (32 - bits);
+}
+
+static void sha1Block(uint32_t state[5], const uint8_t block[64])
+{
+  uint32_t w[80];
+  for (int i = 0; i < 16; i++)
+    w[i] = (uint32_t)block[4 * i] << 24 | block[4 * i + 1] << 16 | block[4 * i + 2] << 8 | block[4 * i + 3];
+  for (int i = 16; i < 80; i++)
+    w[i] = rotate(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+  uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+  for (int i = 0; i < 80; i++)
+  {
+    uint32_t f, k;
+    if (i < 20)
+      f = (b & c) | (~b & d), k = 0x5A827999;
+    else if (i < 40)
+      f = b ^ c ^ d, k = 0x6ED9EBA1;
+    else if (i < 60)
+      f = (b & c) | (b & d) | (c & d), k = 0x8F1BBCDC;
+    else
+      f = b ^ c ^ d, k = 0xCA62C1D6;
+    uint32_t t = rotate(a, 5) + f + e + k + w[i];
+    e = d, d = c, c = rotate(b, 30), b = a, a = t;
+  }
+  state[0] += a, state[1] += b, state[2] += c, state[3] += d, state[4] += e;
+}
+
+void sha1(const uint8_t *data, uint32_t size, uint8_t hash[20])
+{
+  uint32_t state[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+  uint8_t block[64];
+  uint32_t i = 0;
+  for (; i + 64 <= size; i += 64)
+    sha1Block(state, data + i);
+
+  uint32_t rest = size - i;
+  memset(block, 0, sizeof(block));
+  memcpy(block, data + i, rest);
+  block[rest] = 0x80;
+  if (rest >= 56)
+  {
+    sha1Block(state, block);
+    memset(block, 0, sizeof(block));
+  }
+  uint64_t bits = (uint64_t)size * 8;
+  for (int b = 0; b < 8; b++)
+    block[63 - b] = bits >> (8 * b);
+  sha1Block(state, block);
+
+  for (int b = 0; b < 20; b++)
+    hash[b] = state[b / 4] >> (24 - 8 * (b % 4));
+}
+
+void sha1(const char *data, uint32_t size, uint8_t hash[20])
+{
+  sha1((const uint8_t *)data, size, hash);
+}
+
+void sha1(const String &data, uint8_t hash[20])
+{
+  sha1(data.c_str(), data.length(), hash);
+}
+
+void base64_init_encodestate(base64_encodestate *state_in)
+{
+  state_in->step = step_A;
+  state_in->result = 0;
+  state_in->stepcount = 0;
+}
+
+char base64_encode_value(char value_in)
+{
+  static const char *encoding = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  if (value_in > 63)
+    return '=';
+  return encoding[(int)value_in];
+}
+
+int base64_encode_block(const char *plaintext_in, int length_in, char *code_out, base64_encodestate *state_in)
+{
+  const char *plainchar = plaintext_in;
+  const char *const plaintextend = plaintext_in + length_in;
+  char *codechar = code_out;
+  char result = state_in->result;
+  char fragment;
+
+  switch (state_in->step)
+  {
+    while (1)
+    {
+    case step_A:
+      if (plainchar == plaintextend)
+      {
+        state_in->result = result;
+        state_in->step = step_A;
+        return codechar - code_out;
+      }
+      fragment = *plainchar++;
+      result = (fragment & 0x0fc) >> 2;
+      *codechar++ = base64_encode_value(result);
+      result = (fragment & 0x003) << 4;
+    case step_B:
+      if (plainchar == plaintextend)
+      {
+        state_in->result = result;
+        state_in->step = step_B;
+        return codechar - code_out;
+      }
+      fragment = *plainchar++;
+      result |= (fragment & 0x0f0) >> 4;
+      *codechar++ = base64_encode_value(result);
+      result = (fragment & 0x00f) << 2;
+    case step_C:
+      if (plainchar == plaintextend)
+      {
+        state_in->result = result;
+        state_in->step = step_C;
+        return codechar - code_out;
+      }
+      fragment = *plainchar++;
+      result |= (fragment & 0x0c0) >> 6;
+      *codechar++ = base64_encode_value(result);
+      result = (fragment & 0x03f) >> 0;
+      *codechar++ = base64_encode_value(result);
+      ++(state_in->stepcount);
+    }
+  }
+  return codechar - code_out;
+}
+
+int base64_encode_blockend(char *code_out, base64_encodestate *state_in)
+{
+  char *codechar = code_out;
+
+  switch (state_in->step)
+  {
+  case step_B:
+    *codechar++ = base64_encode_value(state_in->result);
+    *codechar++ = '=';
+    *codechar++ = '=';
+    break;
+  case step_C:
+    *codechar++ = base64_encode_value(state_in->result);
+    *codechar++ = '=';
+    break;
+  case step_A:
+    break;
+  }
+  *codechar = 0x00;
+  return codechar - code_out;
+}
+
+int base64_encode_chars(const char *plaintext_in, int length_in, char *code_out)
+{
+  base64_encodestate state;
+  base64_init_encodestate(&state);
+  int len = base64_encode_block(plaintext_in, length_in, code_out, &state);
+  return len + base64_encode_blockend(code_out + len, &state);
+}
@@ -0,0 +1,449 @@
+// Plays a scripted trace (see year.trace) against the schedule and watering
+// engine on the virtual clock: programs, zone edits, button presses, clock
+// steps and power cycles. The loop runs once per simulated second, like the
+// firmware's loop() would see it, and every valve transition is written to a
+// trace file. At the end it reports what ran and the engine throughput.
+//
+//   simulator <trace> <valves>
+//
+// Fails when two valves are open at once, a valve stays open longer than
+// its zone runs, a program is missed or repeated on a day the clock ran
+// straight, or the config read back after a power cycle differs.
+
+#include <Arduino.h>
+#include <Ticker.h>
+#include <TimeLib.h>
+#include <chrono>
+#include <new>
+#include "sprinkler.h"
+#include "sprinkler-device.h"
+#include "includes/ButtonEvents.h"
+#include "includes/PrintBuffer.h"
+
+#define BTN_PIN 0
+#define LED_PIN 13
+
+static void setupDevice()
+{
+  pinMode(LED_PIN, OUTPUT);
+  pinMode(BTN_PIN, INPUT);
+
+  Button.onShortPress(StaticDelegate::bind<SprinklerClass, &SprinklerClass::toggle>(&Sprinkler));
+  Button.onLongPress(StaticDelegate::bind<SprinklerClass, &SprinklerClass::togglePause>(&Sprinkler));
+  Button.onDoublePress(StaticDelegate::bind<SprinklerClass, &SprinklerClass::startNextZone>(&Sprinkler));
+  Button.setup(BTN_PIN);
+}
+
+extern SprinklerDevice Device = SprinklerDevice(setupDevice, LED_PIN, {12, 14, 15});
+
+typedef PrintBuffer<SCHEDULE_WEEK_JSON_SIZE + SPRINKLER_ZONES_JSON_SIZE> ConfigJSON;
+
+static FILE *valves;
+static bool ok = true;
+
+static struct
+{
+  uint32_t days;
+  uint32_t commands;
+  uint32_t clockSteps;
+  uint32_t reboots;
+  uint32_t due;
+  uint32_t ran;
+  uint32_t manual;
+  uint32_t skipped;
+  uint32_t repeated;
+  uint32_t transitions;
+  uint32_t notifications;
+  uint64_t passes;
+} stats;
+
+// what happened today, judged at midnight
+static struct
+{
+  time_t midnight;
+  time_t pending[8];  // program times still due today, in order
+  uint8_t pendingCount;
+  uint8_t due;
+  uint8_t ran;
+  bool clockStepped;
+  bool rebooted;
+} today;
+
+// the valve that is open, and since when
+static int openZone = -1;
+static uint32_t openSince;
+
+static const char *stamp(time_t t)
+{
+  static char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d %02d:%02d:%02d",
+           year(t), month(t), day(t), hour(t), minute(t), second(t));
+  return buffer;
+}
+
+static bool check(bool condition, const char *what)
+{
+  if (!condition)
+  {
+    printf("FAIL %s: %s\n", stamp(now()), what);
+    ok = false;
+  }
+  return condition;
+}
+
+static int zoneOf(uint8_t pin)
+{
+  SprinklerZones &zones = Device.zones();
+  for (uint8_t i = 0; i < zones.count(); i++)
+  {
+    if (zones[i].pin == pin)
+      return i;
+  }
+  return -1;
+}
+
+static void watchValve(uint8_t pin, uint8_t value)
+{
+  int zone = zoneOf(pin);
+  if (zone < 0)
+    return;
+
+  stats.transitions++;
+  fprintf(valves, "%s zone %d %s\n", stamp(now()), zone + 1, value ? "on" : "off");
+
+  if (value)
+  {
+    check(openZone < 0, "two valves open at once");
+    openZone = zone;
+    openSince = millis();
+  }
+  else if (openZone == zone)
+  {
+    unsigned long limit = Device.zones()[zone].duration;
+    check(!limit || millis() - openSince <= limit, "valve open longer than its zone runs");
+    openZone = -1;
+  }
+}
+
+// the enabled programs still ahead today, call it whenever they change
+static void plan()
+{
+  time_t t = now();
+  int dow = weekday(t);
+  today.pendingCount = 0;
+
+  ScheduleClass *programs[] = {&Schedule, &Schedule.get((timeDayOfWeek_t)dow)};
+  for (ScheduleClass *program : programs)
+  {
+    if (!program->isEnabled())
+      continue;
+
+    time_t at = today.midnight + AlarmHMS(program->getHour(), program->getMinute(), 0);
+    if (at <= t)
+      continue;
+
+    uint8_t i = today.pendingCount++;
+    for (; i > 0 && today.pending[i - 1] > at; i--)
+      today.pending[i] = today.pending[i - 1];
+    today.pending[i] = at;
+  }
+}
+
+static void closeDay()
+{
+  if (!today.midnight)
+    return;
+
+  stats.days++;
+  stats.due += today.due;
+  if (today.ran < today.due)
+    stats.skipped += today.due - today.ran;
+  if (today.ran > today.due)
+    stats.repeated += today.ran - today.due;
+
+  if (today.ran != today.due)
+  {
+    const char *why = today.clockStepped ? "clock stepped" : today.rebooted ? "power cycled" : nullptr;
+    printf("%.10s %s: %u of %u programs ran%s%s\n", stamp(today.midnight), dayShortStr(weekday(today.midnight)),
+           today.ran, today.due, why ? ", " : "", why ? why : "");
+    // a clock step may skip or repeat a program, a power cut may skip one
+    check(today.clockStepped || (today.rebooted && today.ran < today.due), "program missed or repeated");
+  }
+}
+
+static void loop()
+{
+  time_t t = now();
+  if (previousMidnight(t) != today.midnight)
+  {
+    closeDay();
+    today = {};
+    today.midnight = previousMidnight(t);
+    plan();
+  }
+
+  while (today.pendingCount && t >= today.pending[0])
+  {
+    today.due++;
+    memmove(today.pending, today.pending + 1, --today.pendingCount * sizeof(today.pending[0]));
+  }
+
+  bool watering = Sprinkler.isWatering();
+  Schedule.handle();
+  if (!watering && Sprinkler.isWatering())
+  {
+    stats.ran++;
+    today.ran++;
+  }
+
+  Sprinkler.handle();
+  Button.handle();
+  Device.handle();
+  stats.passes++;
+}
+
+static void run(unsigned long ms, unsigned long step)
+{
+  for (unsigned long i = 0; i < ms; i += step)
+  {
+    shimAdvance(step);
+    loop();
+  }
+}
+
+static void press(unsigned long ms)
+{
+  shimInterrupt(BTN_PIN, LOW);
+  run(ms, 10);
+  shimInterrupt(BTN_PIN, HIGH);
+  run(50, 10);
+}
+
+// the manual starts, from the button or the web UI, are not programs
+static void manually(void (*action)())
+{
+  bool watering = Sprinkler.isWatering();
+  action();
+  if (!watering && Sprinkler.isWatering())
+    stats.manual++;
+}
+
+static void config(ConfigJSON &json)
+{
+  json.clear();
+  Schedule.toJSON(json);
+  Sprinkler.zonesToJSON(json);
+}
+
+static void boot()
+{
+  Device.setup();
+  Sprinkler.setup(Device);
+  Sprinkler.onChange([] { stats.notifications++; });
+  Schedule.attach();  // NTP sets the clock once the WiFi is up
+}
+
+// power is cut: the relays drop, whatever was not committed is lost
+static void reboot(unsigned long seconds)
+{
+  static ConfigJSON before, after;
+  config(before);
+
+  SprinklerZones &zones = Device.zones();
+  for (uint8_t i = 0; i < zones.count(); i++)
+    digitalWrite(zones[i].pin, LOW);
+  Sprinkler.~SprinklerClass();
+  Button.~ButtonEvents();
+  Device.~SprinklerDevice();
+  Schedule.~ScheduleWeek();
+
+  shimAdvance(seconds * 1000);
+
+  new (&Schedule) ScheduleWeek();
+  new (&Sprinkler) SprinklerClass();
+  new (&Device) SprinklerDevice(setupDevice, LED_PIN, {12, 14, 15});
+  new (&Button) ButtonEvents();
+  boot();
+
+  config(after);
+  check(strcmp(before.c_str(), after.c_str()) == 0, "config read back after the power cycle differs");
+  today.rebooted = true;
+  stats.reboots++;
+}
+
+static bool parseTime(const char *date, const char *time, time_t &t)
+{
+  int y, mo, d, h, mi, s;
+  if (sscanf(date, "%d-%d-%d", &y, &mo, &d) != 3 || sscanf(time, "%d:%d:%d", &h, &mi, &s) != 3)
+    return false;
+
+  tmElements_t tm = {(uint8_t)s, (uint8_t)mi, (uint8_t)h, 0, (uint8_t)d, (uint8_t)mo, (uint8_t)(y - 1970)};
+  t = makeTime(tm);
+  return true;
+}
+
+// one trace line, false ends the trace
+static bool command(char *line, int number)
+{
+  char date[16], time[16], name[16];
+  int args = 0;
+  if (sscanf(line, "%15s %15s %15s %n", date, time, name, &args) != 3)
+  {
+    printf("line %d: expected <date> <time> <command>\n", number);
+    return ok = false;
+  }
+
+  time_t at;
+  if (!parseTime(date, time, at))
+  {
+    printf("line %d: bad time %s %s\n", number, date, time);
+    return ok = false;
+  }
+
+  const char *rest = line + args;
+  if (strcmp(name, "boot") == 0)
+  {
+    setTime(at);
+    boot();
+    return true;
+  }
+
+  if (timeStatus() == timeNotSet)
+  {
+    printf("line %d: the trace must start with boot\n", number);
+    return ok = false;
+  }
+
+  // lines at or before the clock run right away, a clock stepped back
+  // waits for the time to come round again
+  if (at > now())
+    run((at - now()) * 1000, 1000);
+  stats.commands++;
+
+  int zone, minutes, hours, mins, delta;
+  char which[16], state[8];
+  unsigned long seconds = 0;
+  if (strcmp(name, "end") == 0)
+  {
+    return false;
+  }
+  else if (strcmp(name, "zone") == 0 && sscanf(rest, "%d %d %n", &zone, &minutes, &args) == 2)
+  {
+    Sprinkler.setZone(zone - 1, rest + args, minutes);
+  }
+  else if (strcmp(name, "program") == 0 && sscanf(rest, "%15s %d:%d %d %7s", which, &hours, &mins, &minutes, state) == 5)
+  {
+    int enable = strcmp(state, "on") == 0;
+    if (strcmp(which, "everyday") == 0)
+      Sprinkler.schedule(hours, mins, minutes, enable);
+    else if (Schedule.parseDay(which) != -1)
+      Sprinkler.schedule((timeDayOfWeek_t)Schedule.parseDay(which), hours, mins, minutes, enable);
+    else
+      return printf("line %d: no such program %s\n", number, which), ok = false;
+    plan();
+  }
+  else if (strcmp(name, "start") == 0)
+  {
+    manually([] { Sprinkler.start(); });
+  }
+  else if (strcmp(name, "stop") == 0)
+  {
+    Sprinkler.stop();
+  }
+  else if (strcmp(name, "press") == 0 && sscanf(rest, "%15s", which) == 1)
+  {
+    if (strcmp(which, "short") == 0)
+    {
+      // the short press is told from a double one once the window closes
+      press(80);
+      manually([] { run(BUTTON_DOUBLE_PRESS_MS, 10); });
+    }
+    else if (strcmp(which, "long") == 0)
+    {
+      press(BUTTON_LONG_PRESS_MS + 200);
+    }
+    else if (strcmp(which, "double") == 0)
+    {
+      press(80);
+      run(100, 10);
+      press(80);
+    }
+    else
+      return printf("line %d: no such press %s\n", number, which), ok = false;
+  }
+  else if (strcmp(name, "clock") == 0 && sscanf(rest, "%d", &delta) == 1)
+  {
+    // what an NTP sync does when the offset changed
+    setTime(now() + delta);
+    Schedule.attach();
+    today.clockStepped = true;
+    stats.clockSteps++;
+  }
+  else if (strcmp(name, "reboot") == 0)
+  {
+    sscanf(rest, "%lu", &seconds);
+    reboot(seconds);
+  }
+  else
+  {
+    printf("line %d: cannot read %s", number, line);
+    return ok = false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc != 3)
+  {
+    printf("usage: %s <trace> <valves>\n", argv[0]);
+    return 2;
+  }
+
+  FILE *trace = fopen(argv[1], "r");
+  valves = fopen(argv[2], "w");
+  if (!trace || !valves)
+  {
+    printf("cannot open %s or %s\n", argv[1], argv[2]);
+    return 2;
+  }
+
+  shimInterrupt(BTN_PIN, HIGH);  // released, the button is active low
+  shimWatchPins(watchValve);
+
+  typedef std::chrono::steady_clock clock;
+  clock::time_point begin = clock::now();
+  time_t first = 0;
+
+  char line[256];
+  int number = 0;
+  while (fgets(line, sizeof(line), trace))
+  {
+    number++;
+    char *p = line + strspn(line, " \t");
+    if (*p == '#' || *p == '\n' || !*p)
+      continue;
+    line[strcspn(line, "\r\n")] = 0;
+
+    if (!command(p, number))
+      break;
+    if (!first)
+      first = now();
+  }
+  closeDay();
+
+  double wall = std::chrono::duration<double>(clock::now() - begin).count();
+  uint64_t events = stats.ran + stats.manual + stats.transitions + stats.notifications + stats.commands;
+  fclose(trace);
+  fclose(valves);
+
+  printf("%u days, %u commands, %u clock steps, %u power cycles\n",
+         stats.days, stats.commands, stats.clockSteps, stats.reboots);
+  printf("programs: %u due, %u ran, %u skipped, %u repeated, %u manual runs\n",
+         stats.due, stats.ran, stats.skipped, stats.repeated, stats.manual);
+  printf("valves: %u transitions, %u notifications, trace in %s\n", stats.transitions, stats.notifications, argv[2]);
+  printf("%llu loop passes, %llu events in %.2f s: %.1f M passes/s, %.0f events/s, %.0fx real time\n",
+         (unsigned long long)stats.passes, (unsigned long long)events, wall,
+         stats.passes / wall / 1e6, events / wall, (now() - first) / wall);
+  return ok ? 0 : 1;
+}
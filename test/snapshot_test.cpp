@@ -0,0 +1,213 @@
+// /api/snapshot of SprinklerHttp on loopback connections: the ETag and 304,
+// long-polls held until the version moves on or the wait is up, and the
+// waiters budget answering 304 once SNAPSHOT_MAX_WAITING are held. Built
+// with AddressSanitizer like http_test, a waiter answered after its
+// connection closed fails it.
+
+#include <Arduino.h>
+#include <Ticker.h>
+#include <TimeLib.h>
+#include <string>
+#include <ESPAsyncWebServer.h>
+#include "sprinkler.h"
+#include "sprinkler-device.h"
+
+extern SprinklerDevice Device = SprinklerDevice([] {}, 13, {12, 14, 15});
+
+// the firmware update handlers need the Updater and outgoing connections,
+// neither of which the shim has, they never take a request here
+#define AsyncHTTPUpdateHandler_H
+#define AsyncHTTPUpgradeHandler_H
+
+class AsyncHTTPUpdateHandler : public AsyncWebHandler
+{
+public:
+  AsyncHTTPUpdateHandler(const String &uri, WebRequestMethodComposite method) { (void)uri, (void)method; }
+  virtual bool canHandle(AsyncWebServerRequest *request) override { (void)request; return false; }
+};
+
+class AsyncHTTPUpgradeHandler : public AsyncWebHandler
+{
+public:
+  AsyncHTTPUpgradeHandler(const String &uri, WebRequestMethodComposite method, const String &firmware) { (void)uri, (void)method, (void)firmware; }
+  virtual bool canHandle(AsyncWebServerRequest *request) override { (void)request; return false; }
+};
+
+#include "sprinkler-http.h"
+
+#define ADDRESS 0x0104a8c0  // 192.168.4.1
+
+static AsyncAdmissionServer server(80);
+static SprinklerWss wss;
+static SprinklerHttp http;
+
+static bool check(bool condition, const char *what)
+{
+  if (!condition)
+    printf("FAIL: %s\n", what);
+  return condition;
+}
+
+// acks and polls until the server has nothing left to say
+static void settle(ShimPeer *peer)
+{
+  for (int i = 0; i < 8 && peer->open(); i++)
+  {
+    peer->ack();
+    peer->poll();
+  }
+}
+
+static int responses(ShimPeer *peer, const char *status)
+{
+  int n = 0;
+  for (const char *at = peer->received(); (at = strstr(at, status)); at++)
+    n++;
+  return n;
+}
+
+// the ETag of the last response, with its quotes
+static std::string etag(ShimPeer *peer)
+{
+  const char *at = peer->received(), *found = nullptr;
+  while ((at = strstr(at, "ETag: ")))
+    found = at += 6;
+  return found ? std::string(found, strcspn(found, "\r")) : std::string();
+}
+
+// every request from another address, the rate limit is http_test's
+static ShimPeer *get(const std::string &match, int wait)
+{
+  static uint32_t host;
+  std::string request = "GET /api/snapshot";
+  if (wait)
+    request += "?wait=" + std::to_string(wait);
+  request += " HTTP/1.1\r\nHost: sprinkler\r\n";
+  if (!match.empty())
+    request += "If-None-Match: " + match + "\r\n";
+  request += "\r\n";
+
+  ShimPeer *peer = ShimPeer::connect(80, ADDRESS + (++host % 200 << 24));
+  peer->send(request.c_str());
+  settle(peer);
+  return peer;
+}
+
+// a setting the snapshot carries, for the version to move on
+static void edit()
+{
+  static int i;
+  Sprinkler.setDuration(15 * 60 * 1000 + ++i % 2);
+}
+
+static bool conditional()
+{
+  bool ok = true;
+
+  ShimPeer *peer = get("", 0);
+  std::string current = etag(peer);
+  ok &= check(responses(peer, "HTTP/1.1 200") == 1, "the snapshot is answered");
+  ok &= check(strstr(peer->received(), "\"schedule\": ") && strstr(peer->received(), "\"settings\": "), "it carries the schedule and the settings");
+  ok &= check(current == "\"" + std::to_string(Sprinkler.getVersion() + Device.changes()) + "\"", "the ETag is the version");
+  delete peer;
+
+  peer = get(current, 0);
+  ok &= check(responses(peer, "HTTP/1.1 304") == 1 && etag(peer) == current, "the current ETag is answered 304");
+  delete peer;
+
+  edit();
+  peer = get(current, 0);
+  ok &= check(responses(peer, "HTTP/1.1 200") == 1 && etag(peer) != current, "an old ETag gets the new snapshot");
+  delete peer;
+  return ok;
+}
+
+static bool longPoll()
+{
+  bool ok = true;
+
+  ShimPeer *peer = get("", 0);
+  std::string current = etag(peer);
+  delete peer;
+
+  peer = get(current, 5);
+  http.handle();
+  settle(peer);
+  ok &= check(peer->receivedLength() == 0 && peer->open(), "a long-poll at the current version is held");
+  ok &= check(server.getStats().held == 1 && server.getStats().active == 0, "it counts against the held budget");
+
+  edit();
+  http.handle();
+  settle(peer);
+  ok &= check(responses(peer, "HTTP/1.1 200") == 1 && etag(peer) != current, "a change answers it with the snapshot");
+  ok &= check(server.getStats().held == 0, "the answered long-poll leaves the held budget");
+  current = etag(peer);
+  delete peer;
+
+  peer = get(current, 5);
+  shimAdvance(4999);
+  http.handle();
+  settle(peer);
+  ok &= check(peer->receivedLength() == 0, "the long-poll waits out its time");
+  shimAdvance(1);
+  http.handle();
+  settle(peer);
+  ok &= check(responses(peer, "HTTP/1.1 304") == 1 && etag(peer) == current, "then it is answered 304");
+  delete peer;
+  return ok;
+}
+
+// more waiters than slots, and waiters leaving before they are answered
+static bool waiters()
+{
+  bool ok = true;
+
+  ShimPeer *peer = get("", 0);
+  std::string current = etag(peer);
+  delete peer;
+
+  ShimPeer *waiting[SNAPSHOT_MAX_WAITING + 1];
+  for (ShimPeer *&peer : waiting)
+    peer = get(current, SNAPSHOT_MAX_WAIT);
+  ok &= check(server.getStats().held == SNAPSHOT_MAX_WAITING, "SNAPSHOT_MAX_WAITING long-polls are held");
+  ok &= check(responses(waiting[SNAPSHOT_MAX_WAITING], "HTTP/1.1 304") == 1, "one more is answered 304 right away");
+
+  // a closed waiter frees its slot for the next one
+  delete waiting[0];
+  ok &= check(server.getStats().held == SNAPSHOT_MAX_WAITING - 1, "a closed long-poll leaves the held budget");
+  waiting[0] = get(current, SNAPSHOT_MAX_WAIT);
+  ok &= check(waiting[0]->receivedLength() == 0 && server.getStats().held == SNAPSHOT_MAX_WAITING, "its slot takes the next long-poll");
+
+  delete waiting[1];
+  waiting[1] = nullptr;
+  edit();
+  http.handle();
+  for (ShimPeer *peer : waiting)
+  {
+    if (peer)
+      settle(peer);
+  }
+  for (int i = 2; i < SNAPSHOT_MAX_WAITING; i++)
+    ok &= check(responses(waiting[i], "HTTP/1.1 200") == 1, "a change answers every held long-poll");
+  ok &= check(responses(waiting[0], "HTTP/1.1 200") == 1, "the long-poll in the freed slot too");
+  ok &= check(server.getStats().held == 0, "nothing is held after");
+
+  for (ShimPeer *peer : waiting)
+    delete peer;
+  return ok;
+}
+
+int main()
+{
+  tmElements_t start = {0, 30, 7, 2, 5, 4, 2021 - 1970};  // Mon 5 Apr 2021 07:30:00
+  setTime(makeTime(start));
+  Sprinkler.setup(Device);
+
+  http.setup(server, wss);
+  server.begin();
+
+  bool ok = conditional();
+  ok &= longPoll();
+  ok &= waiters();
+  return ok ? 0 : 1;
+}
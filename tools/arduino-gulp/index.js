@@ -1,4 +1,7 @@
+const fs = require('fs');
 const path = require('path');
+const crypto = require('crypto');
+const zlib = require('zlib');
 const through = require('through2');
 const webpack = require('webpack-stream');
 
@@ -83,6 +86,210 @@ module.exports =
         });
     },
 
+    buildArchive({ name }) {
+        var mimes = {
+            '.html': 'text/html',
+            '.css': 'text/css',
+            '.js': 'application/javascript',
+            '.json': 'application/json',
+            '.png': 'image/png',
+            '.svg': 'image/svg+xml'
+        };
+        var assets = [];
+        var base = null;
+
+        return through.obj(function (source, encoding, callback) {
+            var file = path.basename(source.path);
+            var gzip = path.extname(file) === '.gz';
+            if (gzip) {
+                file = file.slice(0, -3);
+            }
+
+            base = base || source;
+            assets.push({
+                path: '/' + file,
+                mime: mimes[path.extname(file)] || 'application/octet-stream',
+                encoding: gzip ? 'gzip' : '',
+                contents: source.contents
+            });
+            callback();
+        }, function (callback) {
+            if (!base) {
+                return callback();
+            }
+
+            // the firmware looks assets up with a binary search over strcmp order
+            assets.sort(function (a, b) { return Buffer.compare(Buffer.from(a.path), Buffer.from(b.path)); });
+
+            var symbol = 'SKETCH_' + name.toUpperCase();
+            var blob = [];
+            var offsets = new Map();
+            var strings = new Map();
+            var output = '// generated by buildArchive, do not edit\n\n';
+
+            // every distinct string is stored once in flash
+            var string = function (value) {
+                if (!strings.has(value)) {
+                    strings.set(value, symbol + '_STR_' + strings.size);
+                    output += 'static const char ' + strings.get(value) + '[] PROGMEM = ' + JSON.stringify(value) + ';\n';
+                }
+                return strings.get(value);
+            };
+
+            var entries = assets.map(function (asset) {
+                // assets with the same contents share them
+                if (!offsets.has(asset.contents)) {
+                    offsets.set(asset.contents, blob.length);
+                    for (var b of asset.contents) { blob.push(b); }
+                    while (blob.length % 4) { blob.push(0); }  // keep every asset word aligned
+                }
+
+                var etag = '"' + crypto.createHash('sha1').update(asset.contents).digest('hex').slice(0, 16) + '"';
+                return '  {' + [
+                    string(asset.path),
+                    string(asset.mime),
+                    offsets.get(asset.contents),
+                    asset.contents.length,
+                    string(etag),
+                    string(asset.encoding)
+                ].join(', ') + '},\n';
+            });
+
+            output += '\nconst uint8_t ' + symbol + '[] PROGMEM __attribute__((aligned(4))) = {';
+            for (var i = 0; i < blob.length; i++) {
+                if (i > 0) { output += ','; }
+                if (0 === (i % 20)) { output += '\n'; }
+                output += '0x' + ('00' + blob[i].toString(16)).slice(-2);
+            }
+            output += '\n};\n\n';
+
+            output += '#define ' + symbol + '_COUNT ' + assets.length + '\n';
+            output += 'const AssetEntry ' + symbol + '_INDEX[] PROGMEM = {\n' + entries.join('') + '};\n';
+
+            var destination = base.clone();
+            destination.path = path.join(path.dirname(base.path), name + '.h');
+            destination.contents = Buffer.from(output);
+            this.push(destination);
+            callback();
+        });
+    },
+
+    buildInjectable({ marker }) {
+        // reflected CRC-32, the polynomial gzip uses
+        var table = [];
+        for (var n = 0; n < 256; n++) {
+            var c = n;
+            for (var k = 0; k < 8; k++) {
+                c = c & 1 ? (0xedb88320 ^ (c >>> 1)) : c >>> 1;
+            }
+            table.push(c >>> 0);
+        }
+        var crc32 = function (data) {
+            var crc = 0xffffffff;
+            for (var b of data) {
+                crc = table[(crc ^ b) & 0xff] ^ (crc >>> 8);
+            }
+            return (crc ^ 0xffffffff) >>> 0;
+        };
+
+        // a * b modulo the CRC polynomial, bit 31 is x^0
+        var multmodp = function (a, b) {
+            var m = 0x80000000, p = 0;
+            for (; ;) {
+                if (a & m) {
+                    p = (p ^ b) >>> 0;
+                    if ((a & (m - 1)) === 0) {
+                        break;
+                    }
+                }
+                m >>>= 1;
+                b = b & 1 ? ((b >>> 1) ^ 0xedb88320) >>> 0 : b >>> 1;
+            }
+            return p;
+        };
+
+        // x^(8 * length), what the CRC of the head is multiplied by to skip the tail
+        var shift = function (length) {
+            var p = 0x80000000;
+            for (var i = 0; i < length; i++) {
+                p = multmodp(0x00800000, p);
+            }
+            return p;
+        };
+
+        var bytes = function (name, data) {
+            var output = 'const uint8_t ' + name + '[] PROGMEM __attribute__((aligned(4))) = {';
+            for (var i = 0; i < data.length; i++) {
+                if (i > 0) { output += ','; }
+                if (0 === (i % 20)) { output += '\n'; }
+                output += '0x' + ('00' + data[i].toString(16)).slice(-2);
+            }
+            return output + '\n};\n';
+        };
+
+        var hex = function (value) {
+            return '0x' + ('00000000' + value.toString(16)).slice(-8);
+        };
+
+        return through.obj(function (source, encoding, callback) {
+            var contents = source.contents;
+            var at = contents.indexOf(marker);
+            if (at < 0) {
+                return callback(new Error(marker + ' not found in ' + source.path));
+            }
+
+            var head = contents.slice(0, at);
+            var tail = contents.slice(at + marker.length);
+
+            // one gzip member: the head ends on a byte boundary in a non-final
+            // block, the firmware appends a stored block and the tail deflate
+            var header = Buffer.from([0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0xff]);
+            var headDeflate = Buffer.concat([header, zlib.deflateRawSync(head, { level: 9, finishFlush: zlib.constants.Z_SYNC_FLUSH })]);
+            var tailDeflate = zlib.deflateRawSync(tail, { level: 9 });
+
+            var safename = path.basename(source.path).split('.').join('_').split('-').join('_').toUpperCase();
+            var symbol = 'SKETCH_' + safename;
+            var hash = crypto.createHash('sha1').update(contents).digest('hex').slice(0, 16);
+
+            var output = '// generated by buildInjectable, do not edit\n\n';
+            output += bytes(symbol + '_HEAD', headDeflate) + '\n';
+            output += bytes(symbol + '_TAIL', tailDeflate) + '\n';
+            output += 'const InjectedAsset ' + symbol + '_INJECT = {\n';
+            output += '  ' + symbol + '_HEAD, sizeof(' + symbol + '_HEAD), ' + head.length + ', ' + hex(crc32(head)) + ',\n';
+            output += '  ' + symbol + '_TAIL, sizeof(' + symbol + '_TAIL), ' + tail.length + ', ' + hex(crc32(tail)) + ', ' + hex(shift(tail.length)) + ',\n';
+            output += '  "' + hash + '"\n};\n';
+
+            var destination = source.clone();
+            destination.path = source.path + '.inject.h';
+            destination.contents = Buffer.from(output);
+
+            callback(null, destination);
+        });
+    },
+
+    buildAssetVersions() {
+        return through.obj(function (source, encoding, callback) {
+
+            var base = path.dirname(source.path);
+            var contents = source.contents.toString();
+
+            // ./favicon.png -> ./favicon.png?v=<hash>, versioned urls are served as immutable
+            contents = contents.replace(/(href|src)="(\.?\/[\w\-\/]+\.png)"/g, function (match, attr, url) {
+                var file = path.join(base, url);
+                if (!fs.existsSync(file)) {
+                    return match;
+                }
+                var version = crypto.createHash('sha1').update(fs.readFileSync(file)).digest('hex').slice(0, 8);
+                return attr + '="' + url + '?v=' + version + '"';
+            });
+
+            var destination = source.clone();
+            destination.contents = Buffer.from(contents);
+
+            callback(null, destination);
+        });
+    },
+
     buildVersionHeader() {
         return through.obj(function (source, encoding, callback) {
 